@@ -146,6 +146,29 @@ namespace twoplay
             }
         };
 
+        // May be repeated; each occurrence appends its parameter.
+        class StringListOption : public OptionBase
+        {
+
+            std::vector<std::string> *pOutput;
+
+        public:
+            StringListOption(const std::string &name, std::vector<std::string> *pOutput)
+                :   OptionBase(name),
+                    pOutput(pOutput)
+            {
+            }
+            virtual int Execute(int argcRemaining, const char **argvRemaining)
+            {
+                if (argcRemaining == 0 || argvRemaining[0][0] == '-')
+                {
+                    throw CommandLineException("Expecting a parameter for option " + GetName());
+                }
+                pOutput->push_back(argvRemaining[0]);
+                return 1;
+            }
+        };
+
         int ProcessOption(const std::string &text, int argsRemaining, const char *argv[])
         {
             for (auto option : options)
@@ -209,6 +232,17 @@ namespace twoplay
             options.push_back(new StringOption(option, pResult));
         }
 
+        void AddOption(const std::string &shortOption, const std::string &longOption, std::vector<std::string> *pResult)
+        {
+            options.push_back(new StringListOption("-" + shortOption, pResult));
+            options.push_back(new StringListOption("--" + longOption, pResult));
+        }
+
+        void AddOption(const std::string &option, std::vector<std::string> *pResult)
+        {
+            options.push_back(new StringListOption(option, pResult));
+        }
+
         template <typename T>
         void AddOption(const std::string &shortOption, const std::string &longOption, T *pResult)
         {
@@ -20,13 +20,9 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
-/*////////////////////////////////////////////////////////////////////////////////////////////
-SECURITY WARNING: Please review the security note at the top of GlobMatcher.hpp
-//////////////////////////////////////////////////////////////////////////////////////////*/
-
-
 #include "GlobMatcher.hpp"
-#include <sstream>
+#include <bitset>
+#include <stdexcept>
 
 using namespace std;
 
@@ -39,291 +35,432 @@ static bool isEndOfSegment(char c)
 #endif
 }
 
-class GlobExpression
+// The set of characters accepted at one position of the pattern.
+using CharSet = std::bitset<256>;
+
+static bool isMatchAll(const std::string &pattern)
 {
-    friend class GlobMatcher;
+    return pattern == "" || pattern == "*";
+}
 
-public:
-    virtual ~GlobExpression() {}
+// Parses a pattern into the character sets of its positions. State i means "the first i
+// positions have matched". A '*' doesn't consume a position of its own; it makes the current
+// state loop on any non-separator.
+static void parsePattern(const std::string &pattern, std::vector<CharSet> &positionSets, std::vector<size_t> &loopStates)
+{
+    auto literal = [&positionSets](char c)
+    {
+        CharSet set;
+        set.set((uint8_t)c);
+        positionSets.push_back(set);
+    };
 
-    bool NextMatchesOne(char c) { return next->MatchesOne(c); }
-    bool NextMatches(const char *p)
+    for (size_t i = 0; i < pattern.length(); ++i)
     {
-        // guard against "*?*?*?*?*?*[!b]*" DDOSattacks.
-        if (++backtrackingAttempts > GlobMatcher::MAX_BACKTRACKING_ATTEMPTS)
+        char c = pattern[i];
+        if (c == '\\')
         {
-            throw std::logic_error("Maximum backtracking attempts exceeded. Please simplify your pattern.");
+            if (++i == pattern.length())
+            {
+                throw std::logic_error("Invalid pattern.");
+            }
+            literal(pattern[i]);
         }
-        return next->Matches(p);
-    }
-
-    virtual bool MatchesOne(char c) = 0;
-    virtual bool Matches(const char *p) = 0;
-
-    virtual bool isMatchMany() const { return false; }
-
-    uint64_t backtrackingAttempts = 0;
-    GlobExpression *next = nullptr;
-};
-
-class MatchManyExpression : public GlobExpression
-{
-public:
-    MatchManyExpression() {}
-
-public:
-    virtual bool isMatchMany() const { return true; }
-    using ptr = std::shared_ptr<MatchManyExpression>;
-    static ptr Create() { return std::make_shared<MatchManyExpression>(); }
-
-    virtual bool MatchesOne(char c) override { return isEndOfSegment(c); }
-    bool Matches(const char *p) override
-    {
-        while (true)
+        else if (c == '*')
         {
-            if (next->isMatchMany())
+            loopStates.push_back(positionSets.size());
+        }
+        else if (c == '?')
+        {
+            CharSet set;
+            for (int ch = 0; ch < 256; ++ch)
             {
-                return NextMatches(p); // avoid  "*********" DOS attack. *?*?*?*?*?*?*?* isn't great either.
+                set[ch] = !isEndOfSegment((char)ch);
             }
-            if (isEndOfSegment(*p))
+            positionSets.push_back(set);
+        }
+        else if (c == '[')
+        {
+            std::string alternates;
+            bool inverse = false;
+            ++i;
+            if (i < pattern.length() && pattern[i] == '!')
             {
-                return NextMatches(p);
+                inverse = true;
+                ++i;
             }
-            if (NextMatchesOne(*p))
+            while (true)
             {
-                if (NextMatches(p))
-                {
-                    return true;
-                }
+                if (i == pattern.length())
+                    throw ::logic_error("Invalid pattern.");
+                if (pattern[i] == ']')
+                    break;
+                alternates.push_back(pattern[i]);
+                ++i;
+            }
+            CharSet set;
+            for (int ch = 0; ch < 256; ++ch)
+            {
+                // separators are never allowed to match, even if we parsed it wrong.
+                bool match = alternates.find((char)ch) != string::npos;
+                set[ch] = !isEndOfSegment((char)ch) && match != inverse;
             }
-            ++p;
+            positionSets.push_back(set);
+        }
+        else
+        {
+            literal(c);
         }
     }
-};
+}
 
-class MatchEndExpression : public GlobExpression
+GlobMatcher::GlobMatcher()
 {
-public:
-    MatchEndExpression() {}
+}
 
-public:
-    using ptr = std::shared_ptr<MatchEndExpression>;
-    static ptr Create() { return std::make_shared<MatchEndExpression>(); }
-    bool MatchesOne(char c) override
-    {
-        return isEndOfSegment(c);
-    }
-    bool Matches(const char *p) override
-    {
-        return isEndOfSegment(*p);
-    }
-};
+GlobMatcher::GlobMatcher(const std::string &pattern)
+{
+    SetPattern(pattern);
+}
 
-class MatchOneExpression : public GlobExpression
+GlobMatcher::GlobMatcher(const std::vector<std::string> &patterns, const std::vector<std::string> &exclusions)
+    : patterns(patterns), exclusions(exclusions)
 {
-public:
-    MatchOneExpression() {}
+    Compile();
+}
 
-public:
-    using ptr = std::shared_ptr<MatchOneExpression>;
-    static ptr Create() { return std::make_shared<MatchOneExpression>(); }
+void GlobMatcher::SetPattern(const std::string &pattern)
+{
+    patterns.clear();
+    exclusions.clear();
+    patterns.push_back(pattern);
+    Compile();
+}
+
+void GlobMatcher::AddPattern(const std::string &pattern)
+{
+    patterns.push_back(pattern);
+    Compile();
+}
 
-    bool MatchesOne(char c) override
+void GlobMatcher::AddExclusion(const std::string &pattern)
+{
+    exclusions.push_back(pattern);
+    Compile();
+}
+
+void GlobMatcher::Compile()
+{
+    includeAll = patterns.empty();
+    excludeAll = false;
+    for (const auto &pattern : patterns)
     {
-        return !isEndOfSegment(c);
+        includeAll |= isMatchAll(pattern);
     }
-    bool Matches(const char *p) override
+    for (const auto &pattern : exclusions)
     {
-        if (isEndOfSegment(*p))
-            return false;
-        ++p;
-        return NextMatches(p);
+        excludeAll |= isMatchAll(pattern);
     }
-};
-
-class MatchRunExpression : public GlobExpression
-{
-public:
-    MatchRunExpression(const std::string &text) : text(text) {}
 
-public:
-    using ptr = std::shared_ptr<MatchRunExpression>;
-    static ptr Create(const std::string text) { return std::make_shared<MatchRunExpression>(text); }
-
-    bool MatchesOne(char c) override
+    struct Compiled
+    {
+        std::vector<CharSet> positionSets;
+        std::vector<size_t> loopStates;
+        bool exclusion;
+    };
+    std::vector<Compiled> compiled;
+    if (!includeAll)
+    {
+        for (const auto &pattern : patterns)
+        {
+            compiled.push_back(Compiled{{}, {}, false});
+            parsePattern(pattern, compiled.back().positionSets, compiled.back().loopStates);
+        }
+    }
+    if (!excludeAll)
     {
-        return c == text[0];
+        for (const auto &pattern : exclusions)
+        {
+            compiled.push_back(Compiled{{}, {}, true});
+            parsePattern(pattern, compiled.back().positionSets, compiled.back().loopStates);
+        }
     }
-    bool Matches(const char *p) override
+
+    requiredLiterals.clear();
+    for (const auto &pattern : compiled)
     {
-        const char *match = text.c_str();
-        while (true)
+        if (pattern.exclusion)
         {
-            if (*match == '\0')
+            continue;
+        }
+        // a '*' between two positions breaks a run, as does any position that isn't a single character.
+        std::string longest, run;
+        size_t loop = 0;
+        for (size_t position = 0; position < pattern.positionSets.size(); ++position)
+        {
+            const CharSet &set = pattern.positionSets[position];
+            while (loop < pattern.loopStates.size() && pattern.loopStates[loop] < position)
             {
-                return NextMatches(p);
+                ++loop;
+            }
+            if (loop < pattern.loopStates.size() && pattern.loopStates[loop] == position)
+            {
+                run.clear();
+            }
+            if (set.count() != 1)
+            {
+                run.clear();
+                continue;
+            }
+            for (int ch = 0; ch < 256; ++ch)
+            {
+                if (set[ch])
+                {
+                    run.push_back((char)ch);
+                    break;
+                }
+            }
+            if (run.length() > longest.length())
+            {
+                longest = run;
             }
-            if (*match != *p)
-                return false;
-            ++p;
-            ++match;
         }
+        if (longest.empty())
+        {
+            requiredLiterals.clear();
+            break;
+        }
+        requiredLiterals.push_back(longest);
     }
 
-private:
-    std::string text;
-};
-
-class MatchAlternatesExpression : public GlobExpression
-{
-public:
-    MatchAlternatesExpression(bool inverted, const std::string &alternates) : inverted(inverted), alternates(alternates) {}
-
-public:
-    using ptr = std::shared_ptr<MatchAlternatesExpression>;
-    static ptr Create(bool inverted, const std::string text) { return std::make_shared<MatchAlternatesExpression>(inverted, text); }
+    ClassifyPattern();
 
-    bool MatchesOne(char c)
+    states = 0;
+    for (const auto &pattern : compiled)
     {
-        if (isEndOfSegment(c))
-            return false; // never allowed to match, even if we parsed it wrong.
-        bool match = alternates.find_first_of(c) != string::npos;
-        return match != inverted;
+        states += pattern.positionSets.size() + 1;
     }
-    bool Matches(const char *p)
+    words = (states + WORD_BITS - 1) / WORD_BITS;
+    charMasks.assign(256 * words, 0);
+    loopMasks.assign(words, 0);
+    startMasks.assign(words, 0);
+    patternAcceptMasks.assign(words, 0);
+    exclusionAcceptMasks.assign(words, 0);
+
+    auto setBit = [](std::vector<Word> &masks, size_t offset, size_t bit)
+    {
+        masks[offset + bit / WORD_BITS] |= Word(1) << (bit % WORD_BITS);
+    };
+
+    // Each pattern's initial state precedes its positions, and no character can enter it, so
+    // shifting a final state left never carries into the next pattern.
+    size_t base = 0;
+    for (const auto &pattern : compiled)
     {
-        if (isEndOfSegment(*p))
-            return false; // never allowed to match, even if we parsed it wrong.
-        bool match = alternates.find_first_of(*p) != string::npos;
-        if (match != inverted)
+        size_t positions = pattern.positionSets.size();
+        setBit(startMasks, 0, base);
+        setBit(pattern.exclusion ? exclusionAcceptMasks : patternAcceptMasks, 0, base + positions);
+        for (size_t position = 0; position < positions; ++position)
         {
-            ++p;
-            return NextMatches(p);
+            for (int ch = 0; ch < 256; ++ch)
+            {
+                if (pattern.positionSets[position][ch])
+                {
+                    setBit(charMasks, ch * words, base + position + 1);
+                }
+            }
         }
-        return false;
+        for (size_t state : pattern.loopStates)
+        {
+            setBit(loopMasks, 0, base + state);
+        }
+        base += positions + 1;
     }
-
-private:
-    bool inverted;
-    std::string alternates;
-};
-
-GlobMatcher::GlobMatcher()
-{
 }
 
-GlobMatcher::GlobMatcher(const std::string &pattern)
+void GlobMatcher::ClassifyPattern()
 {
-    SetPattern(pattern);
-}
-
-void GlobMatcher::PushRun(std::string &run)
-{
-    if (run.size() != 0)
-    {
-        expressions.push_back(MatchRunExpression::Create(run));
-        run.resize(0);
-    }
-}
-void GlobMatcher::SetPattern(const std::string &pattern)
-{
-    expressions.resize(0);
-
-    if (pattern == "" || pattern == "*")
+    shape = Shape::General;
+    literal.clear();
+    if (patterns.size() != 1 || !exclusions.empty() || includeAll)
     {
         return;
     }
-    std::stringstream s(pattern);
-    using int_type = std::stringstream::int_type;
-    std::string run;
-    while (true)
+    const std::string &pattern = patterns[0];
+    bool leadingStar = false, trailingStar = false;
+    for (size_t i = 0; i < pattern.length(); ++i)
     {
-        int_type c = s.get();
-        if (c == EOF)
+        char c = pattern[i];
+        if (c == '*' && i == 0)
         {
-            break;
+            leadingStar = true;
         }
-        if (c == '\\')
+        else if (c == '*' && i == pattern.length() - 1)
         {
-            c = s.get();
-            if (c == EOF)
-            {
-                throw std::logic_error("Invalid pattern.");
-            }
-            run.push_back((char)c);
+            trailingStar = true;
         }
-        else if (c == '*')
+        else if (c == '\\' && i + 1 < pattern.length())
         {
-            PushRun(run);
-            expressions.push_back(MatchManyExpression::Create());
+            literal.push_back(pattern[++i]);
         }
-        else if (c == '?')
+        else if (c == '*' || c == '?' || c == '[' || c == '\\' || c == '\0')
         {
-            PushRun(run);
-            expressions.push_back(MatchOneExpression::Create());
+            literal.clear();
+            return;
         }
-        else if (c == '[')
+        else
         {
-            PushRun(run);
-            std::string alternates;
-            bool inverse = false;
-            c = s.get();
-            if (c == '!')
-            {
-                inverse = true;
-                alternates.push_back((char)c);
-                c = s.get();
-            }
-            while (true)
+            literal.push_back(c);
+        }
+    }
+    if (literal.empty())
+    {
+        return;
+    }
+    shape = leadingStar ? (trailingStar ? Shape::Substring : Shape::Suffix)
+                        : (trailingStar ? Shape::Prefix : Shape::Exact);
+}
+
+// Whether literal occurs in text, starting at the beginning of a segment if ANCHOR_START, and
+// finishing at the end of a segment if ANCHOR_END. A '*' at either end of a pattern always matches
+// the rest of its segment, so this is equivalent to running the automaton for the pattern.
+template <bool ANCHOR_START, bool ANCHOR_END>
+static inline bool matchesLiteral(std::string_view text, std::string_view literal)
+{
+    // the usual case: a match at the end (or start) of the whole text.
+    if constexpr (ANCHOR_END)
+    {
+        if (text.ends_with(literal))
+        {
+            size_t pos = text.length() - literal.length();
+            if (!ANCHOR_START || pos == 0 || isEndOfSegment(text[pos - 1]))
             {
-                if (c == EOF)
-                    throw ::logic_error("Invalid pattern.");
-                if (c == ']')
-                    break;
-                alternates.push_back((char)c);
-                c = s.get();
+                return true;
             }
-            expressions.push_back(MatchAlternatesExpression::Create(inverse, alternates));
         }
-        else
+    }
+    else if constexpr (ANCHOR_START)
+    {
+        if (text.starts_with(literal))
         {
-            run.push_back((char)c);
+            return true;
         }
     }
-    PushRun(run);
-    expressions.push_back(MatchEndExpression::Create());
+    else
+    {
+        return text.find(literal) != std::string_view::npos;
+    }
 
-    for (size_t i = 0; i < expressions.size() - 1; ++i)
+    for (size_t pos = text.find(literal); pos != std::string_view::npos; pos = text.find(literal, pos + 1))
     {
-        expressions[i]->next = expressions[i + 1].get();
+        size_t end = pos + literal.length();
+        if ((!ANCHOR_START || pos == 0 || isEndOfSegment(text[pos - 1])) &&
+            (!ANCHOR_END || end == text.length() || isEndOfSegment(text[end])))
+        {
+            return true;
+        }
     }
+    return false;
 }
 
-bool GlobMatcher::Matches(const std::string &text)
+// A match may start at the beginning of any segment, and must finish at the end of a segment.
+// Initial states are re-entered after every separator, so all segments are tried in the same
+// pass. The end of the text is treated as a final '\0' separator.
+bool GlobMatcher::Matches(std::string_view text) const
 {
-    if (expressions.size() == 0)
-        return true;
-    for (auto &expression : expressions)
+    if (excludeAll)
+        return false;
+    switch (shape)
     {
-        expression->backtrackingAttempts = 0;
+    case Shape::Exact:
+        return matchesLiteral<true, true>(text, literal);
+    case Shape::Prefix:
+        return matchesLiteral<true, false>(text, literal);
+    case Shape::Suffix:
+        return matchesLiteral<false, true>(text, literal);
+    case Shape::Substring:
+        return matchesLiteral<false, false>(text, literal);
+    default:
+        break;
     }
-    const char *p = text.c_str();
-    while (true)
+    if (states == 0)
+        return includeAll;
+    if (words != 1)
     {
-        if (expressions[0]->Matches(p))
+        return MatchesMultiWord(text);
+    }
+    const Word *masks = charMasks.data();
+    const Word start = startMasks[0];
+    const Word loop = loopMasks[0];
+    const Word patternAccept = patternAcceptMasks[0];
+    const Word exclusionAccept = exclusionAcceptMasks[0];
+    const bool hasExclusions = exclusionAccept != 0;
+
+    bool included = includeAll;
+    Word state = start;
+    for (size_t i = 0; i <= text.length(); ++i)
+    {
+        char c = i < text.length() ? text[i] : '\0';
+        if (isEndOfSegment(c))
         {
-            return true;
+            if (state & exclusionAccept)
+                return false;
+            if (state & patternAccept)
+            {
+                if (!hasExclusions)
+                    return true;
+                included = true;
+            }
+            if (c == '\0')
+                break;
+            state = ((state << 1) & masks[(uint8_t)c]) | start;
         }
-        while (!isEndOfSegment(*p))
+        else
+        {
+            state = ((state << 1) & masks[(uint8_t)c]) | (state & loop);
+        }
+    }
+    return included;
+}
+
+bool GlobMatcher::MatchesMultiWord(std::string_view text) const
+{
+    auto any = [this](const std::vector<Word> &state, const std::vector<Word> &masks)
+    {
+        for (size_t w = 0; w < words; ++w)
+        {
+            if (state[w] & masks[w])
+                return true;
+        }
+        return false;
+    };
+
+    bool included = includeAll;
+    std::vector<Word> state = startMasks;
+    for (size_t i = 0; i <= text.length(); ++i)
+    {
+        char c = i < text.length() ? text[i] : '\0';
+        bool separator = isEndOfSegment(c);
+        if (separator)
         {
-            ++p;
+            if (any(state, exclusionAcceptMasks))
+                return false;
+            included |= any(state, patternAcceptMasks);
+            if (c == '\0')
+                break;
         }
-        if (*p == '\0')
+        const Word *masks = &charMasks[(uint8_t)c * words];
+        Word carry = 0;
+        for (size_t w = 0; w < words; ++w)
         {
-            return false;
+            Word current = state[w];
+            Word next = ((current << 1) | carry) & masks[w];
+            next |= separator ? startMasks[w] : (current & loopMasks[w]);
+            carry = current >> (WORD_BITS - 1);
+            state[w] = next;
         }
-        ++p;
     }
+    return included;
 }
 
 #ifdef ENABLE_GLOBMATCHER_UNIT_TEST
@@ -345,7 +482,7 @@ static void ExpectException(const std::string &pattern, const std::string &targe
     {
         GlobMatcher matcher(pattern);
 
-        bool match = matcher.Matches(target);
+        matcher.Matches(target);
     }
     catch (const std::exception &e)
     {
@@ -398,12 +535,94 @@ void GlobMatcherTest()
 
     TestMatch("[]", "a", false);
     TestMatch("[!]", "a", true);
+    TestMatch("[!a]", "!", true);
+    TestMatch("[!abc]", "!", true);
+    TestMatch("[!abc]", "b", false);
+
+    TestMatch("src/*.o", "build/src/a.o", true);
+    TestMatch("src/*.o", "build/src/lib/a.o", false);
+    TestMatch("*.o", "build/src/lib/a.o", true);
+    TestMatch("a\\*", "a*", true);
+    TestMatch("a\\*", "ab", false);
+
+    // shapes with specialized matchers.
+    TestMatch("*.o", "a.o/b", true);
+    TestMatch("*.o", "a.ob/c", false);
+    TestMatch("src/*", "x/src/y/z", true);
+    TestMatch("src/*", "x/xsrc/y", false);
+    TestMatch("ab*", "x/abc", true);
+    TestMatch("ab*", "xab", false);
+    TestMatch("*b*", "a/xby/c", true);
+    TestMatch("a/b", "x/a/b/c", true);
+    TestMatch("a/b", "xa/b", false);
+    TestMatch("a/b", "a/bc", false);
+
+    // more than 63 positions: multi-word state vectors.
+    std::string longName(100, 'x');
+    TestMatch(longName, "a/" + longName, true);
+    TestMatch(longName + "?", "a/" + longName, false);
+    TestMatch("*" + longName.substr(0, 70) + "*y", "a/" + longName + "y/b", true);
+    TestMatch("*" + longName.substr(0, 70) + "*y", "a/" + longName + "/y", false);
+
+    {
+        GlobMatcher matcher({"src/*.cpp.o", "*.c.o"}, {"third_party", "*test*"});
+        if (!matcher.Matches("lib/src/a.cpp.o")
+            || !matcher.Matches("lib/b.c.o")
+            || matcher.Matches("lib/src/x/a.cpp.o")
+            || matcher.Matches("third_party/src/c.cpp.o")
+            || matcher.Matches("src/test_d.cpp.o")
+            || matcher.Matches("lib/e.h"))
+        {
+            throw std::logic_error("Test failed.");
+        }
+        GlobMatcher exclusionsOnly({}, {"*.o"});
+        if (!exclusionsOnly.Matches("a/b.h") || exclusionsOnly.Matches("a/b.o"))
+        {
+            throw std::logic_error("Test failed.");
+        }
+        // several multi-word patterns in one matcher.
+        GlobMatcher longMatcher({longName, "y"}, {longName.substr(0, 70) + "*z"});
+        if (!longMatcher.Matches("a/" + longName) || !longMatcher.Matches("y/b")
+            || longMatcher.Matches(longName + "z/y"))
+        {
+            throw std::logic_error("Test failed.");
+        }
+    }
+
+    {
+        GlobMatcher matcher({"*[ab]Web?Srv*.cpp.o", "src/*/x"}, {"*test*"});
+        if (matcher.RequiredLiterals() != std::vector<std::string>{".cpp.o", "src/"})
+        {
+            throw std::logic_error("Test failed.");
+        }
+        GlobMatcher unconstrained({"*.o", "?*"}, {});
+        if (!unconstrained.RequiredLiterals().empty())
+        {
+            throw std::logic_error("Test failed.");
+        }
+    }
+
+    ExpectException("[abc", "a");
+    ExpectException("abc\\", "a");
+
+    {
+        // the same matcher, many targets.
+        GlobMatcher matcher("*[!]*[!]*[!]*[!]x");
+        for (size_t i = 0; i < 100000; ++i)
+        {
+            if (matcher.Matches("aaaaaaaaaaaaaaaa/aaaaaaaaaaaaaaaa"))
+            {
+                throw std::logic_error("Test failed.");
+            }
+        }
+    }
 
     using clock_t = std::chrono::steady_clock;
 
     {
         auto start = clock_t::now();
-        ExpectException("*[!]*[!]*[!]*[!]x", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+        TestMatch("*[!]*[!]*[!]*[!]x", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", false);
+        TestMatch("*?*?*?*?*?*?*?*?*?*?*?*X", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", false);
 
         auto duration = clock_t::now() - start;
         uint64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
@@ -21,37 +21,86 @@
 // SOFTWARE.
 #pragma once 
 /*////////////////////////////////////////////////////////////////////////////////////////////
-SECURITY WARNING: This code may have a potential DDOS vulnerability if used on 
-patterns supplied by remote users.  Perfectly fine for local user input though.
+Patterns are compiled to a bit-parallel NFA (Shift-And), with one state bit per character
+position in the pattern. Matching is a single left-to-right pass over the target, so it
+takes O(n) time for any pattern, with no backtracking.
 
-See analysis at the end of this file.
+Any number of patterns and exclusions can be combined into one matcher. Their states are
+laid side by side in a single state vector, so a target is still scanned once, however many
+patterns there are. Matchers with more than 64 states in total use a multi-word state vector,
+at O(n * states/64).
+
+A single pattern of the form "literal", "literal*", "*literal" or "*literal*" skips the
+automaton, and is matched with string comparisons.
 //////////////////////////////////////////////////////////////////////////////////////////*/
 #include <vector>
-#include <memory>
 #include <string>
+#include <string_view>
+#include <cstdint>
 
 #ifndef NDEBUG
 #define ENABLE_GLOBMATCHER_UNIT_TEST
 #endif
-class GlobExpression;
 
 class GlobMatcher {
 
 public:
-    static constexpr uint64_t MAX_BACKTRACKING_ATTEMPTS =  10000; // see not at head of file.
-
-
     GlobMatcher();
     GlobMatcher(const std::string &pattern);
+    GlobMatcher(const std::vector<std::string> &patterns, const std::vector<std::string> &exclusions);
 
+    // Replaces all patterns and exclusions with a single pattern.
     void SetPattern(const std::string &pattern);
-    bool Matches(const std::string &text);
-private:
-    void PushRun(std::string &run);
 
-    std::vector<std::shared_ptr<GlobExpression>> expressions;
+    // A target matches if it matches any pattern (or there are no patterns), and
+    // doesn't match any exclusion.
+    void AddPattern(const std::string &pattern);
+    void AddExclusion(const std::string &pattern);
 
+    // Thread-safe: a compiled matcher can be shared between threads.
+    bool Matches(std::string_view text) const;
 
+    // Literal strings of which every matching text contains at least one (the longest run of
+    // plain characters in each pattern). Empty if there is no such set, e.g. if a pattern is "*".
+    const std::vector<std::string> &RequiredLiterals() const { return requiredLiterals; }
+
+    // True if no text can match (an exclusion is "*").
+    bool MatchesNothing() const { return excludeAll; }
+private:
+    using Word = uint64_t;
+    static constexpr size_t WORD_BITS = 64;
+
+    // Common single-pattern shapes that are matched with plain string comparisons instead of
+    // the automaton.
+    enum class Shape {
+        General,
+        Exact,     // literal
+        Prefix,    // literal*
+        Suffix,    // *literal
+        Substring  // *literal*
+    };
+
+    void Compile();
+    void ClassifyPattern();
+    bool MatchesMultiWord(std::string_view text) const;
+
+    std::vector<std::string> patterns;
+    std::vector<std::string> exclusions;
+
+    bool includeAll = true;
+    bool excludeAll = false;
+    size_t states = 0;
+    size_t words = 0;                      // words per state vector.
+    std::vector<Word> charMasks;           // [c*words+w]: states that can be entered on c.
+    std::vector<Word> loopMasks;           // [w]: states that loop on non-separators (a '*').
+    std::vector<Word> startMasks;          // [w]: initial state of each pattern.
+    std::vector<Word> patternAcceptMasks;  // [w]: final state of each pattern.
+    std::vector<Word> exclusionAcceptMasks;// [w]: final state of each exclusion.
+
+    std::vector<std::string> requiredLiterals;
+
+    Shape shape = Shape::General;
+    std::string literal;
 };
 
 
@@ -59,28 +108,3 @@ private:
 
 extern void GlobMatcherTest();
 #endif
-
-
-/*////////////////////////////////////////////////////////////////////////////////////////////
-The issue: Worst-case performance for the pattern matcher is N^P (n = target length, P = number of
-* patterns), when faced with patterns that require backtracking to match. The simplest vulnerability 
-is:
-
-   *?*?*?*?*?*?*?*?*?*?*?*X
-
-which is solvable, but variations of `*[!X]*[!Y*[!Z]*` are more difficult to deal with.
-
-The current implementation limits the maimum number of backtracking operations
-and throws an exception if the limit is exeeded. CPU use for a pathological 
-case: < 1 ms. 
-
-However, it's not absolutely clear that this fully addresses the problem. 10,000 backtracks
-x 1,000 *'s applied to five hundred targets? ....
-
-The fix: remove [] functionality, and merge *?*?*?*?* nodes to a new "at least 4 characters"
-node, which would produce O 2^N execution time! (So also limit the maximum complexity of patterns).
-
-Perfectly fine for local use. If a user wants to construct a pathological pattern, so be it. There
-are easier ways to pin a CPU.
-
-///////////////////////////////////////////////////////////////////////////////////////////*/
@@ -0,0 +1,576 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "binary_history.hpp"
+#include "parallel.hpp"
+#include "ss.hpp"
+#include "varint.hpp"
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+static constexpr char FILE_MAGIC[8] = {'N', 'T', 'H', 'I', 'S', 'T', 'B', '1'};
+static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+static constexpr uint32_t SEGMENT_MAGIC = 0x4753544E; // "NTSG"
+static constexpr uint32_t ENCODING_COLUMNS = 0;
+static constexpr uint32_t ENCODING_PACKED = 1;
+
+// Records per block of a packed segment. Each block can be decoded on its own.
+static constexpr size_t BLOCK_RECORDS = 16 * 1024;
+
+// FileHeader::flags
+static constexpr uint32_t FILE_FLAG_PACKED = 1; // new segments are packed.
+
+struct FileHeader {
+    char magic[8];
+    uint32_t byteOrderMark;
+    uint32_t flags;
+};
+
+struct SegmentHeader {
+    uint32_t magic;
+    uint32_t encoding;
+    uint64_t recordCount;
+    uint64_t stringCount;
+    uint64_t stringBytes;
+};
+
+// Follows the SegmentHeader of a packed segment.
+struct PackedHeader {
+    uint64_t blockCount;
+    uint64_t packedBytes;
+};
+
+static_assert(sizeof(FileHeader) == 16);
+static_assert(sizeof(SegmentHeader) == 32);
+static_assert(sizeof(PackedHeader) == 16);
+
+static constexpr size_t align8(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+// Byte offsets of each part of a segment, relative to the start of the segment.
+struct SegmentLayout {
+    size_t mtime, commandHash, startTime, endTime, fileId;
+    size_t stringOffsets, strings;
+    size_t size;
+
+    SegmentLayout(uint64_t recordCount, uint64_t stringCount, uint64_t stringBytes)
+    {
+        mtime = sizeof(SegmentHeader);
+        commandHash = mtime + recordCount * sizeof(uint64_t);
+        startTime = commandHash + recordCount * sizeof(uint64_t);
+        endTime = startTime + recordCount * sizeof(uint32_t);
+        fileId = endTime + recordCount * sizeof(uint32_t);
+        stringOffsets = align8(fileId + recordCount * sizeof(uint32_t));
+        strings = align8(stringOffsets + (stringCount + 1) * sizeof(uint32_t));
+        size = align8(strings + stringBytes);
+    }
+};
+
+// Byte offsets of each part of a packed segment.
+struct PackedSegmentLayout {
+    size_t commandHash, blockOffsets, packed;
+    size_t stringOffsets, strings;
+    size_t size;
+
+    PackedSegmentLayout(uint64_t recordCount, uint64_t stringCount, uint64_t stringBytes, const PackedHeader &packedHeader)
+    {
+        commandHash = sizeof(SegmentHeader) + sizeof(PackedHeader);
+        blockOffsets = commandHash + recordCount * sizeof(uint64_t);
+        packed = blockOffsets + (packedHeader.blockCount + 1) * sizeof(uint64_t);
+        stringOffsets = align8(packed + packedHeader.packedBytes);
+        strings = align8(stringOffsets + (stringCount + 1) * sizeof(uint32_t));
+        size = align8(strings + stringBytes);
+    }
+};
+
+BinaryHistoryFile::BinaryHistoryFile(const std::string &filename)
+    : file_(filename),
+      filename_(filename)
+{
+    const char *data = file_.data();
+    size_t size = file_.size();
+
+    FileHeader header;
+    if (size < sizeof(header))
+    {
+        throw std::invalid_argument(SS("Not a valid history file: " << filename));
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0)
+    {
+        throw std::invalid_argument(SS("Not a valid history file: " << filename));
+    }
+    if (header.byteOrderMark != BYTE_ORDER_MARK)
+    {
+        throw std::invalid_argument(SS("History file was written on a machine with a different byte order: " << filename));
+    }
+    packed_ = (header.flags & FILE_FLAG_PACKED) != 0;
+
+    size_t pos = sizeof(header);
+    while (pos + sizeof(SegmentHeader) <= size)
+    {
+        const SegmentHeader *segmentHeader = (const SegmentHeader *)(data + pos);
+        if (segmentHeader->magic != SEGMENT_MAGIC || (segmentHeader->encoding != ENCODING_COLUMNS && segmentHeader->encoding != ENCODING_PACKED))
+        {
+            break;
+        }
+        if (segmentHeader->recordCount > size || segmentHeader->stringCount > size || segmentHeader->stringBytes > size)
+        {
+            break;
+        }
+        const char *base = data + pos;
+
+        Segment segment{};
+        segment.record_count = segmentHeader->recordCount;
+        PackedSegment packed{};
+        size_t segmentSize, stringOffsetsPos, stringsPos;
+        if (segmentHeader->encoding == ENCODING_PACKED)
+        {
+            if (pos + sizeof(SegmentHeader) + sizeof(PackedHeader) > size)
+            {
+                break;
+            }
+            const PackedHeader *packedHeader = (const PackedHeader *)(base + sizeof(SegmentHeader));
+            if (packedHeader->blockCount != (segment.record_count + BLOCK_RECORDS - 1) / BLOCK_RECORDS || packedHeader->packedBytes > size)
+            {
+                break;
+            }
+            PackedSegmentLayout layout(segmentHeader->recordCount, segmentHeader->stringCount, segmentHeader->stringBytes, *packedHeader);
+            if (pos + layout.size > size)
+            {
+                break;
+            }
+            segment.command_hash = (const uint64_t *)(base + layout.commandHash);
+            packed.data = base + layout.packed;
+            packed.blockOffsets = (const uint64_t *)(base + layout.blockOffsets);
+            packed.blockCount = packedHeader->blockCount;
+            for (size_t i = 0; i < packed.blockCount; ++i)
+            {
+                if (packed.blockOffsets[i + 1] < packed.blockOffsets[i] || packed.blockOffsets[i + 1] > packedHeader->packedBytes)
+                {
+                    throw std::invalid_argument(SS("History file is corrupt: " << filename));
+                }
+            }
+            segmentSize = layout.size;
+            stringOffsetsPos = layout.stringOffsets;
+            stringsPos = layout.strings;
+        }
+        else
+        {
+            SegmentLayout layout(segmentHeader->recordCount, segmentHeader->stringCount, segmentHeader->stringBytes);
+            if (pos + layout.size > size)
+            {
+                break;
+            }
+            segment.mtime = (const uint64_t *)(base + layout.mtime);
+            segment.command_hash = (const uint64_t *)(base + layout.commandHash);
+            segment.start_time_ms = (const uint32_t *)(base + layout.startTime);
+            segment.end_time_ms = (const uint32_t *)(base + layout.endTime);
+            segment.file_id = (const uint32_t *)(base + layout.fileId);
+            segmentSize = layout.size;
+            stringOffsetsPos = layout.stringOffsets;
+            stringsPos = layout.strings;
+        }
+
+        const uint32_t *stringOffsets = (const uint32_t *)(base + stringOffsetsPos);
+        const char *strings = base + stringsPos;
+        for (size_t i = 0; i < segmentHeader->stringCount; ++i)
+        {
+            if (stringOffsets[i + 1] < stringOffsets[i] || stringOffsets[i + 1] > segmentHeader->stringBytes)
+            {
+                throw std::invalid_argument(SS("History file is corrupt: " << filename));
+            }
+            names_.push_back(std::string_view(strings + stringOffsets[i], stringOffsets[i + 1] - stringOffsets[i]));
+        }
+        // file IDs of packed segments are checked as they are decoded.
+        for (size_t i = 0; segment.file_id != nullptr && i < segment.record_count; ++i)
+        {
+            if (segment.file_id[i] >= names_.size())
+            {
+                throw std::invalid_argument(SS("History file is corrupt: " << filename));
+            }
+        }
+        segments_.push_back(segment);
+        packedSegments_.push_back(packed);
+        recordCount_ += segment.record_count;
+        pos += segmentSize;
+    }
+    validSize_ = pos;
+}
+
+void BinaryHistoryFile::decode_block(const Segment &segment, const PackedSegment &packed, size_t block,
+                                     uint64_t *mtime, uint32_t *startTime, uint32_t *endTime, uint32_t *fileId) const
+{
+    const uint8_t *p = (const uint8_t *)packed.data + packed.blockOffsets[block];
+    const uint8_t *end = (const uint8_t *)packed.data + packed.blockOffsets[block + 1];
+    size_t count = std::min(BLOCK_RECORDS, segment.record_count - block * BLOCK_RECORDS);
+
+    uint64_t previousMtime = 0;
+    uint64_t previousStartTime = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t id, mtimeDelta, startTimeDelta, duration;
+        if ((p = readVarint(p, end, &id)) == nullptr ||
+            (p = readVarint(p, end, &mtimeDelta)) == nullptr ||
+            (p = readVarint(p, end, &startTimeDelta)) == nullptr ||
+            (p = readVarint(p, end, &duration)) == nullptr ||
+            id >= names_.size())
+        {
+            throw std::invalid_argument(SS("History file is corrupt: " << filename_));
+        }
+        previousMtime += (uint64_t)unzigzag(mtimeDelta);
+        previousStartTime += (uint64_t)unzigzag(startTimeDelta);
+        fileId[i] = (uint32_t)id;
+        mtime[i] = previousMtime;
+        startTime[i] = (uint32_t)previousStartTime;
+        endTime[i] = (uint32_t)(previousStartTime + (uint64_t)unzigzag(duration));
+    }
+    if (p != end)
+    {
+        throw std::invalid_argument(SS("History file is corrupt: " << filename_));
+    }
+}
+
+void BinaryHistoryFile::decode() const
+{
+    struct BlockRef {
+        size_t segment;
+        size_t block;
+    };
+    std::vector<BlockRef> blocks;
+    columns_.resize(segments_.size());
+    for (size_t i = 0; i < segments_.size(); ++i)
+    {
+        if (packedSegments_[i].data == nullptr)
+        {
+            continue;
+        }
+        auto columns = std::make_unique<Columns>();
+        size_t count = segments_[i].record_count;
+        columns->mtime.resize(count);
+        columns->startTime.resize(count);
+        columns->endTime.resize(count);
+        columns->fileId.resize(count);
+        for (size_t block = 0; block < packedSegments_[i].blockCount; ++block)
+        {
+            blocks.push_back(BlockRef{i, block});
+        }
+        columns_[i] = std::move(columns);
+    }
+    parallel_for(blocks.size(), resolve_thread_count(0),
+        [&](size_t i)
+        {
+            const BlockRef &ref = blocks[i];
+            Columns &columns = *columns_[ref.segment];
+            size_t first = ref.block * BLOCK_RECORDS;
+            decode_block(segments_[ref.segment], packedSegments_[ref.segment], ref.block,
+                         columns.mtime.data() + first, columns.startTime.data() + first,
+                         columns.endTime.data() + first, columns.fileId.data() + first);
+        });
+    for (size_t i = 0; i < segments_.size(); ++i)
+    {
+        if (columns_[i])
+        {
+            segments_[i].mtime = columns_[i]->mtime.data();
+            segments_[i].start_time_ms = columns_[i]->startTime.data();
+            segments_[i].end_time_ms = columns_[i]->endTime.data();
+            segments_[i].file_id = columns_[i]->fileId.data();
+        }
+    }
+}
+
+const std::vector<BinaryHistoryFile::Segment> &BinaryHistoryFile::segments() const
+{
+    std::call_once(decoded_, [this]() { decode(); });
+    return segments_;
+}
+
+std::vector<BinaryHistoryRecord> BinaryHistoryFile::records(size_t begin, size_t end) const
+{
+    std::vector<BinaryHistoryRecord> result;
+    end = std::min(end, recordCount_);
+    if (begin >= end)
+    {
+        return result;
+    }
+    result.reserve(end - begin);
+
+    Columns block;
+    size_t segmentStart = 0;
+    for (size_t s = 0; s < segments_.size() && segmentStart < end; ++s)
+    {
+        const Segment &segment = segments_[s];
+        const PackedSegment &packed = packedSegments_[s];
+        size_t first = std::max(begin, segmentStart) - segmentStart;
+        size_t last = std::min(end - segmentStart, segment.record_count);
+        for (size_t i = first; i < last;)
+        {
+            if (packed.data == nullptr)
+            {
+                result.push_back(record(segment, i));
+                ++i;
+                continue;
+            }
+            // decode the block that holds record i, and take the records of it that are wanted.
+            size_t blockIndex = i / BLOCK_RECORDS;
+            size_t blockStart = blockIndex * BLOCK_RECORDS;
+            size_t blockCount = std::min(BLOCK_RECORDS, segment.record_count - blockStart);
+            block.mtime.resize(blockCount);
+            block.startTime.resize(blockCount);
+            block.endTime.resize(blockCount);
+            block.fileId.resize(blockCount);
+            decode_block(segment, packed, blockIndex, block.mtime.data(), block.startTime.data(), block.endTime.data(), block.fileId.data());
+            for (; i < last && i < blockStart + blockCount; ++i)
+            {
+                BinaryHistoryRecord r;
+                r.mtime = block.mtime[i - blockStart];
+                r.command_hash = segment.command_hash[i];
+                r.start_time_ms = block.startTime[i - blockStart];
+                r.end_time_ms = block.endTime[i - blockStart];
+                r.file_name = names_[block.fileId[i - blockStart]];
+                result.push_back(r);
+            }
+        }
+        segmentStart += segment.record_count;
+    }
+    return result;
+}
+
+const std::unordered_map<std::string_view, uint32_t> &BinaryHistoryFile::name_ids() const
+{
+    if (nameIds_.size() != names_.size())
+    {
+        nameIds_.clear();
+        nameIds_.reserve(names_.size());
+        for (uint32_t i = 0; i < names_.size(); ++i)
+        {
+            nameIds_.emplace(names_[i], i);
+        }
+    }
+    return nameIds_;
+}
+
+BinaryHistoryRecord::BinaryHistoryRecord(const NinjaRecord &record)
+    : mtime(record.mtime),
+      start_time_ms((uint32_t)record.start_time_ms),
+      end_time_ms((uint32_t)record.end_time_ms),
+      file_name(record.file_name)
+{
+    std::from_chars(record.extra.data(), record.extra.data() + record.extra.length(), command_hash, 16);
+}
+
+template <typename T>
+static void writeColumn(std::ostream &f, const std::vector<T> &column)
+{
+    f.write((const char *)column.data(), column.size() * sizeof(T));
+}
+
+static void writePadding(std::ostream &f, size_t size)
+{
+    static const char zeros[8] = {};
+    f.write(zeros, align8(size) - size);
+}
+
+// Writes the packed form of records: their command hashes, the offsets of each block, then the blocks.
+static void writePackedColumns(std::ostream &f, const std::vector<BinaryHistoryRecord> &records, const std::vector<uint32_t> &fileId)
+{
+    std::vector<uint64_t> commandHash;
+    std::vector<uint64_t> blockOffsets;
+    std::string packed;
+
+    commandHash.reserve(records.size());
+    packed.reserve(records.size() * 12);
+
+    uint64_t previousMtime = 0;
+    uint64_t previousStartTime = 0;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        const auto &record = records[i];
+        if (i % BLOCK_RECORDS == 0)
+        {
+            // each block starts from zero, so that it can be decoded without its predecessors.
+            blockOffsets.push_back(packed.size());
+            previousMtime = 0;
+            previousStartTime = 0;
+        }
+        writeVarint(packed, fileId[i]);
+        writeVarint(packed, zigzag((int64_t)(record.mtime - previousMtime)));
+        writeVarint(packed, zigzag((int64_t)record.start_time_ms - (int64_t)previousStartTime));
+        writeVarint(packed, zigzag((int64_t)record.end_time_ms - (int64_t)record.start_time_ms));
+        previousMtime = record.mtime;
+        previousStartTime = record.start_time_ms;
+        commandHash.push_back(record.command_hash);
+    }
+    blockOffsets.push_back(packed.size());
+
+    PackedHeader packedHeader{blockOffsets.size() - 1, packed.size()};
+    f.write((const char *)&packedHeader, sizeof(packedHeader));
+    writeColumn(f, commandHash);
+    writeColumn(f, blockOffsets);
+    f.write(packed.data(), packed.size());
+    writePadding(f, packed.size());
+}
+
+static void writePlainColumns(std::ostream &f, const std::vector<BinaryHistoryRecord> &records, const std::vector<uint32_t> &fileId)
+{
+    std::vector<uint64_t> mtime, commandHash;
+    std::vector<uint32_t> startTime, endTime;
+    mtime.reserve(records.size());
+    commandHash.reserve(records.size());
+    startTime.reserve(records.size());
+    endTime.reserve(records.size());
+    for (const auto &record : records)
+    {
+        mtime.push_back(record.mtime);
+        commandHash.push_back(record.command_hash);
+        startTime.push_back(record.start_time_ms);
+        endTime.push_back(record.end_time_ms);
+    }
+    writeColumn(f, mtime);
+    writeColumn(f, commandHash);
+    writeColumn(f, startTime);
+    writeColumn(f, endTime);
+    writeColumn(f, fileId);
+    writePadding(f, records.size() * sizeof(uint32_t) * 3);
+}
+
+static void writeSegment(
+    std::ostream &f,
+    const std::vector<BinaryHistoryRecord> &records,
+    size_t firstNewId,
+    std::unordered_map<std::string_view, uint32_t> &nameIds,
+    bool packed)
+{
+    std::vector<uint32_t> fileId;
+    std::vector<std::string_view> newNames;
+    fileId.reserve(records.size());
+    for (const auto &record : records)
+    {
+        auto it = nameIds.find(record.file_name);
+        if (it == nameIds.end())
+        {
+            it = nameIds.emplace(record.file_name, (uint32_t)(firstNewId + newNames.size())).first;
+            newNames.push_back(record.file_name);
+        }
+        fileId.push_back(it->second);
+    }
+
+    std::vector<uint32_t> stringOffsets;
+    stringOffsets.reserve(newNames.size() + 1);
+    uint64_t stringBytes = 0;
+    for (auto name : newNames)
+    {
+        stringOffsets.push_back((uint32_t)stringBytes);
+        stringBytes += name.length();
+    }
+    stringOffsets.push_back((uint32_t)stringBytes);
+    if (stringBytes > UINT32_MAX)
+    {
+        throw std::logic_error("Too many file names in history segment.");
+    }
+
+    SegmentHeader header{SEGMENT_MAGIC, packed ? ENCODING_PACKED : ENCODING_COLUMNS, records.size(), newNames.size(), stringBytes};
+    f.write((const char *)&header, sizeof(header));
+    if (packed)
+    {
+        writePackedColumns(f, records, fileId);
+    }
+    else
+    {
+        writePlainColumns(f, records, fileId);
+    }
+    writeColumn(f, stringOffsets);
+    writePadding(f, stringOffsets.size() * sizeof(uint32_t));
+    for (auto name : newNames)
+    {
+        f.write(name.data(), name.length());
+    }
+    writePadding(f, stringBytes);
+}
+
+static void writeFileHeader(std::ostream &f, bool packed)
+{
+    FileHeader header;
+    memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.byteOrderMark = BYTE_ORDER_MARK;
+    header.flags = packed ? FILE_FLAG_PACKED : 0;
+    f.write((const char *)&header, sizeof(header));
+}
+
+void BinaryHistoryFile::create(const std::string &filename, bool packed)
+{
+    write(filename, std::vector<BinaryHistoryRecord>(), packed);
+}
+
+void BinaryHistoryFile::write(const std::string &filename, const std::vector<BinaryHistoryRecord> &records, bool packed)
+{
+    std::string tmpFile = filename + ".$$$";
+    {
+        std::ofstream f(tmpFile, std::ios_base::binary | std::ios_base::trunc);
+        if (!f.is_open())
+        {
+            throw std::invalid_argument(SS("Can't open file " << tmpFile));
+        }
+        writeFileHeader(f, packed);
+        if (records.size() != 0)
+        {
+            std::unordered_map<std::string_view, uint32_t> nameIds;
+            writeSegment(f, records, 0, nameIds, packed);
+        }
+        f.close();
+        if (!f)
+        {
+            throw std::invalid_argument(SS("Can't write file " << tmpFile));
+        }
+    }
+    std::filesystem::rename(tmpFile, filename);
+}
+
+void BinaryHistoryFile::append(const std::string &filename, const BinaryHistoryFile &history, const std::vector<BinaryHistoryRecord> &records)
+{
+    if (records.size() == 0)
+    {
+        return;
+    }
+    // discard any incomplete segment left by an interrupted append.
+    if (history.valid_size() != history.file_.size())
+    {
+        std::filesystem::resize_file(filename, history.valid_size());
+    }
+
+    std::unordered_map<std::string_view, uint32_t> nameIds = history.name_ids();
+    std::ofstream f(filename, std::ios_base::binary | std::ios_base::app);
+    if (!f.is_open())
+    {
+        throw std::invalid_argument(SS("Can't open file " << filename));
+    }
+    writeSegment(f, records, history.name_count(), nameIds, history.packed());
+    f.close();
+    if (!f)
+    {
+        throw std::invalid_argument(SS("Can't write file " << filename));
+    }
+}
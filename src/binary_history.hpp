@@ -0,0 +1,146 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "mapped_file.hpp"
+#include "ninja_log_reader.hpp"
+
+// A record, as stored in a BinaryHistoryFile.
+struct BinaryHistoryRecord {
+    uint64_t mtime = 0;
+    uint64_t command_hash = 0;
+    uint32_t start_time_ms = 0;
+    uint32_t end_time_ms = 0;
+    std::string_view file_name;
+
+    BinaryHistoryRecord() {}
+    // The record's start and end times must fit in 32 bits.
+    BinaryHistoryRecord(const NinjaRecord &record);
+};
+
+// A column-oriented binary build history (.ninja_log.history.bin).
+//
+// The file is a header followed by a sequence of segments. Each run that adds records appends one
+// segment, so the file is never rewritten except when it is compacted. A segment holds
+// the mtime, start-time, end-time, command hash and file ID of its records, followed by
+// the file names that were first seen in that segment. File IDs index the concatenation of the
+// string tables of all segments.
+//
+// Segments are normally plain columns, which are used directly from the memory mapping, in native
+// byte order, so a query doesn't parse anything. A file may instead be written packed: in blocks
+// of records, each record stored as varints of its file ID, the deltas of its mtime and start time
+// from the previous record's, and its duration. A record then takes about 12 bytes (plus its 8-byte
+// command hash) rather than the 28 of plain columns, but its blocks must be decoded (in parallel,
+// on first use of segments()) before it can be queried, which makes queries several times slower.
+// Segments are appended in the encoding that the file was created with.
+class BinaryHistoryFile {
+public:
+    struct Segment {
+        size_t record_count;
+        const uint64_t *mtime;
+        const uint64_t *command_hash;
+        const uint32_t *start_time_ms;
+        const uint32_t *end_time_ms;
+        const uint32_t *file_id;
+    };
+
+    BinaryHistoryFile(const std::string &filename);
+
+    BinaryHistoryRecord record(const Segment &segment, size_t index) const
+    {
+        BinaryHistoryRecord result;
+        result.mtime = segment.mtime[index];
+        result.command_hash = segment.command_hash[index];
+        result.start_time_ms = segment.start_time_ms[index];
+        result.end_time_ms = segment.end_time_ms[index];
+        result.file_name = names_[segment.file_id[index]];
+        return result;
+    }
+
+    const MappedFile &file() const { return file_; }
+
+    // Whether new segments are packed.
+    bool packed() const { return packed_; }
+
+    // Decodes packed segments, the first time it's called.
+    const std::vector<Segment> &segments() const;
+    size_t record_count() const { return recordCount_; }
+
+    // Records [begin, end) of the whole history. Only the blocks that hold them are decoded.
+    std::vector<BinaryHistoryRecord> records(size_t begin, size_t end) const;
+
+    size_t name_count() const { return names_.size(); }
+    std::string_view name(uint32_t fileId) const { return names_[fileId]; }
+
+    // Map of file name to file ID. Built on first use.
+    const std::unordered_map<std::string_view, uint32_t> &name_ids() const;
+
+    // Size of the valid part of the file. A segment left incomplete by an interrupted
+    // append is ignored, and overwritten by the next append.
+    size_t valid_size() const { return validSize_; }
+
+    // Creates an empty history file.
+    static void create(const std::string &filename, bool packed = false);
+
+    // Appends a segment containing records to filename, which has been loaded into history, in
+    // the history's encoding.
+    static void append(const std::string &filename, const BinaryHistoryFile &history, const std::vector<BinaryHistoryRecord> &records);
+
+    // Writes a new history file containing a single segment.
+    static void write(const std::string &filename, const std::vector<BinaryHistoryRecord> &records, bool packed = false);
+
+private:
+    // Where a packed segment's blocks are.
+    struct PackedSegment {
+        const char *data;
+        const uint64_t *blockOffsets; // blockCount + 1 offsets into data.
+        size_t blockCount;
+    };
+    // Decoded columns of a packed segment.
+    struct Columns {
+        std::vector<uint64_t> mtime;
+        std::vector<uint32_t> startTime, endTime, fileId;
+    };
+
+    void decode_block(const Segment &segment, const PackedSegment &packed, size_t block,
+                      uint64_t *mtime, uint32_t *startTime, uint32_t *endTime, uint32_t *fileId) const;
+    void decode() const;
+
+    MappedFile file_;
+    std::string filename_;
+    bool packed_ = false;
+    size_t validSize_ = 0;
+    size_t recordCount_ = 0;
+    mutable std::vector<Segment> segments_;
+    std::vector<PackedSegment> packedSegments_; // one per segment; data is null for plain segments.
+    mutable std::vector<std::unique_ptr<Columns>> columns_;
+    mutable std::once_flag decoded_;
+    std::vector<std::string_view> names_;
+    mutable std::unordered_map<std::string_view, uint32_t> nameIds_;
+};
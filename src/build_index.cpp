@@ -0,0 +1,238 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "build_index.hpp"
+#include "parallel.hpp"
+#include "ss.hpp"
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+static constexpr const char *BUILD_INDEX_HEADER = "# ninja_times builds v1";
+
+void BuildSession::add(uint64_t startTimeMs, uint64_t endTimeMs, uint64_t mtime, std::string_view fileName)
+{
+    ++record_count;
+    min_start_time_ms = std::min(min_start_time_ms, startTimeMs);
+    max_end_time_ms = std::max(max_end_time_ms, endTimeMs);
+    uint64_t duration = endTimeMs - startTimeMs;
+    cpu_time_ms += duration;
+    this->mtime = std::max(this->mtime, mtime);
+    if (duration > slowest_ms || slowest_file.empty())
+    {
+        slowest_ms = duration;
+        slowest_file = fileName;
+    }
+}
+
+void BuildSession::merge(const BuildSession &next)
+{
+    end = next.end;
+    record_count += next.record_count;
+    min_start_time_ms = std::min(min_start_time_ms, next.min_start_time_ms);
+    max_end_time_ms = std::max(max_end_time_ms, next.max_end_time_ms);
+    cpu_time_ms += next.cpu_time_ms;
+    mtime = std::max(mtime, next.mtime);
+    if (next.slowest_ms > slowest_ms)
+    {
+        slowest_ms = next.slowest_ms;
+        slowest_file = next.slowest_file;
+    }
+}
+
+uint64_t BuildIndex::resume(const MappedFile &history)
+{
+    uint64_t position = checkpoint_.resume_offset(history);
+    if (position == 0 || builds_.empty())
+    {
+        builds_.clear();
+        return 0;
+    }
+    position = builds_.back().begin;
+    builds_.pop_back();
+    return position;
+}
+
+// The records of a chunk of a text history, split into builds. A chunk's first build may
+// continue the last build of the previous chunk.
+struct ChunkBuilds {
+    std::vector<BuildSession> builds;
+    uint64_t firstEndTimeMs = 0;
+    uint64_t lastEndTimeMs = 0;
+};
+
+bool BuildIndex::update(const NinjaLogReader &history, size_t threads)
+{
+    std::string_view text = history.text();
+    if (checkpoint_.resume_offset(history.file()) == HistoryCheckpoint::complete_lines_end(text, 0) && !builds_.empty())
+    {
+        return false;
+    }
+    uint64_t start = resume(history.file());
+    uint64_t end = HistoryCheckpoint::complete_lines_end(text, start);
+
+    std::vector<std::string_view> chunks = NinjaLogReader::chunks(text.substr(start, end - start), resolve_thread_count(threads));
+    std::vector<ChunkBuilds> chunkBuilds(chunks.size());
+    parallel_for(chunks.size(), resolve_thread_count(threads),
+        [&](size_t i)
+        {
+            ChunkBuilds &result = chunkBuilds[i];
+            history.for_each(
+                chunks[i],
+                [&](const NinjaRecord &record)
+                {
+                    if (result.builds.empty() || record.end_time_ms < result.lastEndTimeMs)
+                    {
+                        // the build starts at the start of the record's line.
+                        const char *line = record.file_name.data();
+                        while (line > chunks[i].data() && line[-1] != '\n')
+                        {
+                            --line;
+                        }
+                        if (result.builds.empty())
+                        {
+                            result.firstEndTimeMs = record.end_time_ms;
+                        }
+                        else
+                        {
+                            result.builds.back().end = line - text.data();
+                        }
+                        result.builds.emplace_back().begin = line - text.data();
+                    }
+                    result.builds.back().add(record.start_time_ms, record.end_time_ms, record.mtime, record.file_name);
+                    result.lastEndTimeMs = record.end_time_ms;
+                });
+            if (!result.builds.empty())
+            {
+                result.builds.back().end = chunks[i].data() + chunks[i].length() - text.data();
+            }
+        });
+
+    bool continues = false; // whether the next chunk's first record may continue the last build.
+    uint64_t lastEndTimeMs = 0;
+    for (const ChunkBuilds &chunk : chunkBuilds)
+    {
+        if (chunk.builds.empty())
+        {
+            continue;
+        }
+        size_t first = 0;
+        if (continues && chunk.firstEndTimeMs >= lastEndTimeMs)
+        {
+            builds_.back().merge(chunk.builds[0]);
+            first = 1;
+        }
+        builds_.insert(builds_.end(), chunk.builds.begin() + first, chunk.builds.end());
+        continues = true;
+        lastEndTimeMs = chunk.lastEndTimeMs;
+    }
+    checkpoint_ = HistoryCheckpoint(history.file(), end);
+    return true;
+}
+
+bool BuildIndex::update(const BinaryHistoryFile &history)
+{
+    if (checkpoint_.resume_offset(history.file()) == history.valid_size() && !builds_.empty())
+    {
+        return false;
+    }
+    uint64_t start = resume(history.file());
+
+    // only the records from the start of the last build are read.
+    std::vector<BinaryHistoryRecord> records = history.records(start, history.record_count());
+    uint64_t lastEndTimeMs = 0;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        const BinaryHistoryRecord &record = records[i];
+        if (i == 0 || record.end_time_ms < lastEndTimeMs)
+        {
+            if (i != 0)
+            {
+                builds_.back().end = start + i;
+            }
+            builds_.emplace_back().begin = start + i;
+        }
+        builds_.back().add(record.start_time_ms, record.end_time_ms, record.mtime, record.file_name);
+        lastEndTimeMs = record.end_time_ms;
+    }
+    if (!builds_.empty())
+    {
+        builds_.back().end = history.record_count();
+    }
+    checkpoint_ = HistoryCheckpoint(history.file(), history.valid_size());
+    return true;
+}
+
+bool BuildIndex::load(const std::string &filename)
+{
+    std::ifstream f(filename);
+    if (!f.is_open())
+    {
+        return false;
+    }
+    std::string header;
+    size_t count = 0;
+    if (!std::getline(f, header) || header != BUILD_INDEX_HEADER || !checkpoint_.read(f) || !(f >> count))
+    {
+        *this = BuildIndex();
+        return false;
+    }
+    builds_.resize(count);
+    for (BuildSession &build : builds_)
+    {
+        f >> build.begin >> build.end >> build.record_count >> build.min_start_time_ms >> build.max_end_time_ms >> build.cpu_time_ms >> build.mtime >> build.slowest_ms;
+        f.get(); // the tab before the file name.
+        std::getline(f, build.slowest_file);
+    }
+    if (f.fail())
+    {
+        *this = BuildIndex();
+        return false;
+    }
+    return true;
+}
+
+void BuildIndex::save(const std::string &filename) const
+{
+    std::string tmpFile = filename + ".$$$";
+    {
+        std::ofstream f(tmpFile);
+        if (!f.is_open())
+        {
+            throw std::invalid_argument(SS("Can't open file " << tmpFile));
+        }
+        f << BUILD_INDEX_HEADER << '\n';
+        checkpoint_.write(f);
+        f << builds_.size() << '\n';
+        for (const BuildSession &build : builds_)
+        {
+            f << build.begin << ' ' << build.end << ' ' << build.record_count << ' '
+              << build.min_start_time_ms << ' ' << build.max_end_time_ms << ' ' << build.cpu_time_ms << ' '
+              << build.mtime << ' ' << build.slowest_ms << '\t' << build.slowest_file << '\n';
+        }
+        f.close();
+        if (!f)
+        {
+            throw std::invalid_argument(SS("Can't write file " << tmpFile));
+        }
+    }
+    std::filesystem::rename(tmpFile, filename);
+}
@@ -0,0 +1,84 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "binary_history.hpp"
+#include "history_checkpoint.hpp"
+#include "ninja_log_reader.hpp"
+
+// One build invocation, found in a history's stream of records, with its aggregates.
+struct BuildSession {
+    // Position of the build's first record: a byte offset in a text history, or a record index
+    // in a binary history.
+    uint64_t begin = 0;
+    // Position just past its last record.
+    uint64_t end = 0;
+
+    uint64_t record_count = 0;
+    uint64_t min_start_time_ms = UINT64_MAX;
+    uint64_t max_end_time_ms = 0;
+    uint64_t cpu_time_ms = 0;  // sum of record durations.
+    uint64_t mtime = 0;        // latest output mtime: when the build finished.
+    uint64_t slowest_ms = 0;
+    std::string slowest_file;
+
+    uint64_t wall_time_ms() const { return record_count == 0 ? 0 : max_end_time_ms - min_start_time_ms; }
+
+    void add(uint64_t startTimeMs, uint64_t endTimeMs, uint64_t mtime, std::string_view fileName);
+    // Adds the aggregates of a session that continues this one.
+    void merge(const BuildSession &next);
+};
+
+// Index of the build invocations in a history (.ninja_log.history.builds, or
+// .ninja_log.history.bin.builds).
+//
+// Ninja restarts its clock at each invocation, and records are merged into the history in the
+// order that edges finished, so an end time lower than the previous one starts a new build.
+// A build is a contiguous range of the history, so the records of one build can be read
+// without reading the rest of the history.
+//
+// Updates read only the records added since the index was last updated, along with those of
+// the last build, which may have continued (if the history was merged while ninja was still
+// running). If the history has been rewritten, the index is rebuilt.
+class BuildIndex {
+public:
+    // Returns false if the index doesn't exist, or is not valid.
+    bool load(const std::string &filename);
+    void save(const std::string &filename) const;
+
+    // Return true if the index changed.
+    bool update(const NinjaLogReader &history, size_t threads);
+    bool update(const BinaryHistoryFile &history);
+
+    // In history order. Build IDs are 1-based indexes into this list.
+    const std::vector<BuildSession> &builds() const { return builds_; }
+
+private:
+    // Position at which indexing resumes, and drops the builds that will be re-indexed.
+    uint64_t resume(const MappedFile &history);
+
+    HistoryCheckpoint checkpoint_;
+    std::vector<BuildSession> builds_;
+};
@@ -0,0 +1,238 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "build_timeline.hpp"
+#include "output_writer.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <iomanip>
+
+void BuildTimeline::load(const std::string &filename)
+{
+    size_t threads = resolve_thread_count(threads_);
+    NinjaLogReader reader(filename);
+    reader.check_header();
+
+    // invocations can only be found in log order, so chunks are parsed in parallel, then concatenated.
+    std::vector<std::string_view> chunks = reader.chunks(threads);
+    std::vector<std::vector<NinjaRecord>> chunkRecords(chunks.size());
+    parallel_for(chunks.size(), threads,
+        [&](size_t i)
+        {
+            reader.for_each(
+                chunks[i],
+                [&](const NinjaRecord &record)
+                {
+                    chunkRecords[i].push_back(record);
+                });
+        });
+    std::vector<NinjaRecord> records;
+    for (auto &chunk : chunkRecords)
+    {
+        records.insert(records.end(), chunk.begin(), chunk.end());
+        chunk = std::vector<NinjaRecord>();
+    }
+
+    std::vector<size_t> starts = invocation_starts(records);
+    invocationCount_ = starts.size();
+    size_t lastStart = starts.empty() ? 0 : starts.back();
+    load(records.data() + lastStart, records.size() - lastStart);
+}
+
+std::vector<size_t> BuildTimeline::invocation_starts(const std::vector<NinjaRecord> &records)
+{
+    std::vector<size_t> result;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        if (i == 0 || records[i].end_time_ms < records[i - 1].end_time_ms)
+        {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+void BuildTimeline::load(const NinjaRecord *records, size_t count)
+{
+    edges_.clear();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const NinjaRecord &record = records[i];
+        // ninja writes the outputs of an edge one after another, with the same times and command hash.
+        if (i != 0 &&
+            record.start_time_ms == records[i - 1].start_time_ms &&
+            record.end_time_ms == records[i - 1].end_time_ms &&
+            record.extra == records[i - 1].extra)
+        {
+            ++edges_.back().output_count;
+            continue;
+        }
+        edges_.push_back(Edge{record.start_time_ms, record.end_time_ms, std::string(record.file_name), 1});
+    }
+    std::stable_sort(edges_.begin(), edges_.end(),
+        [](const Edge &a, const Edge &b)
+        {
+            return a.end_time_ms < b.end_time_ms;
+        });
+    sweep();
+    find_critical_path();
+}
+
+void BuildTimeline::sweep()
+{
+    wallTimeMs_ = 0;
+    edgeTimeMs_ = 0;
+    peakConcurrency_ = 0;
+    lowConcurrencyTimeMs_ = 0;
+    if (edges_.empty())
+    {
+        return;
+    }
+
+    // +1 at each start, -1 at each end. Ends sort before starts at the same time, so that an edge
+    // that starts as another finishes doesn't count as running concurrently with it.
+    std::vector<std::pair<uint64_t, int32_t>> events;
+    events.reserve(edges_.size() * 2);
+    uint64_t firstStart = UINT64_MAX, lastEnd = 0;
+    for (const Edge &edge : edges_)
+    {
+        events.push_back({edge.start_time_ms, +1});
+        events.push_back({edge.end_time_ms, -1});
+        edgeTimeMs_ += edge.duration_ms();
+        firstStart = std::min(firstStart, edge.start_time_ms);
+        lastEnd = std::max(lastEnd, edge.end_time_ms);
+    }
+    wallTimeMs_ = lastEnd - firstStart;
+    std::sort(events.begin(), events.end());
+
+    // the low-concurrency threshold depends on the peak, so the time spent at each level is
+    // collected first.
+    std::vector<uint64_t> timeAtConcurrency(1);
+    int32_t active = 0;
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        active += events[i].second;
+        if ((size_t)active >= timeAtConcurrency.size())
+        {
+            timeAtConcurrency.resize(active + 1);
+        }
+        if (i + 1 < events.size())
+        {
+            timeAtConcurrency[active] += events[i + 1].first - events[i].first;
+        }
+    }
+    peakConcurrency_ = (uint32_t)(timeAtConcurrency.size() - 1);
+    for (size_t level = 0; level * 2 < peakConcurrency_; ++level)
+    {
+        lowConcurrencyTimeMs_ += timeAtConcurrency[level];
+    }
+}
+
+void BuildTimeline::find_critical_path()
+{
+    criticalPath_.clear();
+    if (edges_.empty())
+    {
+        return;
+    }
+    // edges are sorted by end time, so each predecessor is found with a binary search among
+    // the edges that precede the current one.
+    size_t current = edges_.size() - 1;
+    while (true)
+    {
+        criticalPath_.push_back(current);
+        uint64_t start = edges_[current].start_time_ms;
+        auto it = std::upper_bound(edges_.begin(), edges_.begin() + current, start,
+            [](uint64_t time, const Edge &edge)
+            {
+                return time < edge.end_time_ms;
+            });
+        if (it == edges_.begin())
+        {
+            break;
+        }
+        current = (size_t)(it - edges_.begin()) - 1;
+    }
+    std::reverse(criticalPath_.begin(), criticalPath_.end());
+}
+
+double BuildTimeline::average_concurrency() const
+{
+    return wallTimeMs_ == 0 ? 0.0 : (double)edgeTimeMs_ / wallTimeMs_;
+}
+
+uint64_t BuildTimeline::idle_core_time_ms() const
+{
+    return peakConcurrency_ * wallTimeMs_ - edgeTimeMs_;
+}
+
+uint64_t BuildTimeline::critical_path_time_ms() const
+{
+    uint64_t result = 0;
+    for (size_t index : criticalPath_)
+    {
+        result += edges_[index].duration_ms();
+    }
+    return result;
+}
+
+static double percent(uint64_t value, uint64_t total)
+{
+    return total == 0 ? 0.0 : value * 100.0 / total;
+}
+
+std::ostream &operator<<(std::ostream &s, const BuildTimeline &timeline)
+{
+    StreamFormatGuard formatGuard(s);
+    s << std::setprecision(3) << std::fixed;
+    s << "Build " << timeline.invocation_count() << " of " << timeline.invocation_count()
+      << ": " << timeline.edges().size() << " edges, wall time " << timeline.wall_time_ms() / 1000.0 << "s." << '\n';
+    s << "Concurrency: average " << std::setprecision(1) << timeline.average_concurrency()
+      << ", peak " << timeline.peak_concurrency() << "." << '\n';
+    s << std::setprecision(3)
+      << "Idle core time: " << timeline.idle_core_time_ms() / 1000.0 << "s ("
+      << std::setprecision(1) << percent(timeline.idle_core_time_ms(), timeline.peak_concurrency() * timeline.wall_time_ms())
+      << "% of " << timeline.peak_concurrency() << " cores)." << '\n';
+    s << std::setprecision(3)
+      << "Below half of peak concurrency: " << timeline.low_concurrency_time_ms() / 1000.0 << "s ("
+      << std::setprecision(1) << percent(timeline.low_concurrency_time_ms(), timeline.wall_time_ms()) << "% of wall time)." << '\n';
+    s << '\n';
+
+    s << std::setprecision(3)
+      << "Critical path: " << timeline.critical_path().size() << " edges, " << timeline.critical_path_time_ms() / 1000.0 << "s ("
+      << std::setprecision(1) << percent(timeline.critical_path_time_ms(), timeline.wall_time_ms()) << "% of wall time)." << '\n';
+    s << std::setw(10) << "start" << std::setw(10) << "end" << std::setw(10) << "time" << "  file" << '\n';
+    s << std::setprecision(3);
+    for (size_t index : timeline.critical_path())
+    {
+        const BuildTimeline::Edge &edge = timeline.edges()[index];
+        s << std::setw(10) << edge.start_time_ms / 1000.0
+          << std::setw(10) << edge.end_time_ms / 1000.0
+          << std::setw(10) << edge.duration_ms() / 1000.0
+          << "  " << edge.file_name;
+        if (edge.output_count > 1)
+        {
+            s << " (and " << edge.output_count - 1 << " more outputs)";
+        }
+        s << '\n';
+    }
+    return s;
+}
@@ -0,0 +1,96 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ninja_log_reader.hpp"
+
+// The timeline of one build invocation, reconstructed from the start and end times of its
+// log records: concurrency, and the chain of edges that bounded the build's wall time.
+//
+// The log doesn't record dependencies, so the critical path is found heuristically: working
+// backwards from the last edge to finish, each edge's predecessor is taken to be the edge that
+// finished most recently before it started (the edge it was most likely waiting for).
+class BuildTimeline {
+public:
+    struct Edge {
+        uint64_t start_time_ms;
+        uint64_t end_time_ms;
+        std::string file_name;  // the first output.
+        uint32_t output_count;
+
+        uint64_t duration_ms() const { return end_time_ms - start_time_ms; }
+    };
+
+    // Number of threads used to load the log. 0 (the default) uses one thread per core.
+    void set_threads(size_t threads) { threads_ = threads; }
+
+    // Loads the most recent build invocation in a .ninja_log.
+    void load(const std::string &filename);
+
+    // Builds the timeline from the records of a single invocation, in log order.
+    void load(const NinjaRecord *records, size_t count);
+
+    // Ninja restarts its clock at each invocation, and writes records as edges finish, so an end
+    // time lower than the previous one starts a new invocation. Returns the index of the first
+    // record of each invocation.
+    static std::vector<size_t> invocation_starts(const std::vector<NinjaRecord> &records);
+
+    // Invocations in the log that load(filename) read; the timeline is the last of them.
+    size_t invocation_count() const { return invocationCount_; }
+
+    // Sorted by end time. Records of an edge with several outputs are collapsed into one edge.
+    const std::vector<Edge> &edges() const { return edges_; }
+
+    uint64_t wall_time_ms() const { return wallTimeMs_; }
+    uint64_t edge_time_ms() const { return edgeTimeMs_; }  // sum of edge durations.
+    uint32_t peak_concurrency() const { return peakConcurrency_; }
+    double average_concurrency() const;
+
+    // Core time left unused, if peak_concurrency() cores were available for the whole build.
+    uint64_t idle_core_time_ms() const;
+
+    // Wall time during which fewer than half of peak_concurrency() edges were running.
+    uint64_t low_concurrency_time_ms() const { return lowConcurrencyTimeMs_; }
+
+    // Indexes into edges(), earliest first.
+    const std::vector<size_t> &critical_path() const { return criticalPath_; }
+    uint64_t critical_path_time_ms() const;
+
+private:
+    void sweep();
+    void find_critical_path();
+
+    size_t threads_ = 0;
+    size_t invocationCount_ = 0;
+    std::vector<Edge> edges_;
+    uint64_t wallTimeMs_ = 0;
+    uint64_t edgeTimeMs_ = 0;
+    uint32_t peakConcurrency_ = 0;
+    uint64_t lowConcurrencyTimeMs_ = 0;
+    std::vector<size_t> criticalPath_;
+};
+
+std::ostream &operator<<(std::ostream &s, const BuildTimeline &timeline);
@@ -0,0 +1,173 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "delimiter_scanner.hpp"
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DELIMITER_SCANNER_X86
+#include <immintrin.h>
+#endif
+
+static size_t scanScalar(const char *block, size_t length, uint32_t *positions)
+{
+    // branch-free: always store, but only advance past delimiters.
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        char c = block[i];
+        positions[count] = (uint32_t)i;
+        count += (c == '\t') | (c == '\n');
+    }
+    return count;
+}
+
+#ifdef DELIMITER_SCANNER_X86
+
+static inline size_t extractPositions(uint32_t mask, uint32_t offset, uint32_t *positions)
+{
+    size_t count = 0;
+    while (mask != 0)
+    {
+        positions[count++] = offset + (uint32_t)__builtin_ctz(mask);
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+__attribute__((target("sse2"))) static size_t scanSse2(const char *block, size_t length, uint32_t *positions)
+{
+    const __m128i tabs = _mm_set1_epi8('\t');
+    const __m128i newlines = _mm_set1_epi8('\n');
+
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + i));
+        __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(v, tabs), _mm_cmpeq_epi8(v, newlines));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(matches);
+        count += extractPositions(mask, (uint32_t)i, positions + count);
+    }
+    for (; i < length; ++i)
+    {
+        char c = block[i];
+        positions[count] = (uint32_t)i;
+        count += (c == '\t') | (c == '\n');
+    }
+    return count;
+}
+
+__attribute__((target("avx2"))) static size_t scanAvx2(const char *block, size_t length, uint32_t *positions)
+{
+    const __m256i tabs = _mm256_set1_epi8('\t');
+    const __m256i newlines = _mm256_set1_epi8('\n');
+
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + i));
+        __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(v, tabs), _mm256_cmpeq_epi8(v, newlines));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(matches);
+        count += extractPositions(mask, (uint32_t)i, positions + count);
+    }
+    for (; i < length; ++i)
+    {
+        char c = block[i];
+        positions[count] = (uint32_t)i;
+        count += (c == '\t') | (c == '\n');
+    }
+    return count;
+}
+
+#endif
+
+bool DelimiterScanner::is_supported(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::Scalar:
+        return true;
+#ifdef DELIMITER_SCANNER_X86
+    case Isa::Sse2:
+        return __builtin_cpu_supports("sse2");
+    case Isa::Avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+DelimiterScanner::Isa DelimiterScanner::best_isa()
+{
+    // evaluated once; __builtin_cpu_supports is cheap, but not free.
+    static const Isa best =
+        is_supported(Isa::Avx2)   ? Isa::Avx2
+        : is_supported(Isa::Sse2) ? Isa::Sse2
+                                  : Isa::Scalar;
+    return best;
+}
+
+const char *DelimiterScanner::isa_name(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::Scalar:
+        return "scalar";
+    case Isa::Sse2:
+        return "sse2";
+    case Isa::Avx2:
+        return "avx2";
+    default:
+        return "unknown";
+    }
+}
+
+DelimiterScanner::DelimiterScanner()
+    : DelimiterScanner(best_isa())
+{
+}
+
+DelimiterScanner::DelimiterScanner(Isa isa)
+    : isa_(isa)
+{
+    if (!is_supported(isa))
+    {
+        throw std::invalid_argument(std::string("Instruction set not supported: ") + isa_name(isa));
+    }
+    switch (isa)
+    {
+#ifdef DELIMITER_SCANNER_X86
+    case Isa::Sse2:
+        scanFn_ = scanSse2;
+        break;
+    case Isa::Avx2:
+        scanFn_ = scanAvx2;
+        break;
+#endif
+    default:
+        scanFn_ = scanScalar;
+        break;
+    }
+}
@@ -0,0 +1,60 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Finds the offsets of all '\t' and '\n' bytes in a block of text.
+//
+// The widest instruction set supported by the CPU (AVX2, SSE2, or plain C++) is
+// selected at runtime.
+class DelimiterScanner {
+public:
+    enum class Isa {
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    DelimiterScanner();
+    DelimiterScanner(Isa isa);
+
+    static Isa best_isa();
+    static bool is_supported(Isa isa);
+    static const char *isa_name(Isa isa);
+
+    Isa isa() const { return isa_; }
+
+    // Writes the offsets of delimiters in block[0..length) to positions, in ascending order,
+    // and returns the number written. positions must have room for `length` entries.
+    size_t scan(const char *block, size_t length, uint32_t *positions) const
+    {
+        return scanFn_(block, length, positions);
+    }
+
+private:
+    using ScanFn = size_t (*)(const char *block, size_t length, uint32_t *positions);
+
+    Isa isa_;
+    ScanFn scanFn_;
+};
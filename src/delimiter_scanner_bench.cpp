@@ -0,0 +1,139 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Micro-benchmark: delimiter scanning and record parsing over a synthetic log, for each
+// instruction set that the CPU supports.
+//
+// Syntax: delimiter_scanner_bench [size_in_mb]    (default: 1024)
+
+#include "delimiter_scanner.hpp"
+#include "ninja_log_reader.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static std::string makeSyntheticLog(size_t size)
+{
+    std::string result;
+    result.reserve(size + 256);
+    result += "# ninja log v5\n";
+
+    std::mt19937_64 random(1);
+    uint64_t mtime = 1689600000000000000ULL;
+    uint64_t time = 0;
+    while (result.size() < size)
+    {
+        uint64_t duration = 100 + random() % 30000;
+        uint64_t file = random() % 20000;
+        result += std::to_string(time);
+        result += '\t';
+        result += std::to_string(time + duration);
+        result += '\t';
+        result += std::to_string(mtime + time * 1000000);
+        result += "\tsrc/CMakeFiles/libpipedald.dir/module";
+        result += std::to_string(file % 40);
+        result += "/File";
+        result += std::to_string(file);
+        result += ".cpp.o\t";
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)random());
+        result += hash;
+        result += '\n';
+        time += duration / 8;
+    }
+    return result;
+}
+
+template <typename FN>
+static double timeIt(FN &&fn)
+{
+    using clock_t = std::chrono::steady_clock;
+    auto start = clock_t::now();
+    fn();
+    return std::chrono::duration<double>(clock_t::now() - start).count();
+}
+
+int main(int argc, const char **argv)
+{
+    size_t sizeMb = 1024;
+    if (argc > 1)
+    {
+        sizeMb = std::stoul(argv[1]);
+    }
+    cout << "Generating " << sizeMb << "MB synthetic log..." << endl;
+    std::string log = makeSyntheticLog(sizeMb * 1024 * 1024);
+    double mb = log.size() / (1024.0 * 1024.0);
+
+    cout << setw(8) << "isa" << setw(16) << "scan MB/s" << setw(16) << "parse MB/s" << setw(18) << "parse lines/s" << endl;
+
+    for (auto isa : {DelimiterScanner::Isa::Scalar, DelimiterScanner::Isa::Sse2, DelimiterScanner::Isa::Avx2})
+    {
+        if (!DelimiterScanner::is_supported(isa))
+        {
+            cout << setw(8) << DelimiterScanner::isa_name(isa) << "   (not supported)" << endl;
+            continue;
+        }
+        DelimiterScanner scanner(isa);
+
+        constexpr size_t BLOCK_SIZE = 64 * 1024;
+        std::vector<uint32_t> positions(BLOCK_SIZE);
+        size_t delimiters = 0;
+        double scanSeconds = timeIt(
+            [&]()
+            {
+                for (size_t i = 0; i < log.size(); i += BLOCK_SIZE)
+                {
+                    delimiters += scanner.scan(log.data() + i, std::min(BLOCK_SIZE, log.size() - i), positions.data());
+                }
+            });
+
+        NinjaBlockParser parser(isa);
+        size_t records = 0;
+        double parseSeconds = timeIt(
+            [&]()
+            {
+                const char *p = log.data();
+                const char *end = p + log.size();
+                while (p < end)
+                {
+                    p = parser.parse(p, end);
+                    if (p == nullptr)
+                    {
+                        throw std::logic_error("Unexpected parse error.");
+                    }
+                    records += parser.records().size();
+                }
+            });
+
+        cout << setw(8) << DelimiterScanner::isa_name(isa)
+             << setw(16) << setprecision(0) << fixed << mb / scanSeconds
+             << setw(16) << mb / parseSeconds
+             << setw(18) << records / parseSeconds
+             << "   (" << delimiters << " delimiters)" << endl;
+    }
+    return EXIT_SUCCESS;
+}
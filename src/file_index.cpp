@@ -0,0 +1,266 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "file_index.hpp"
+#include "parallel.hpp"
+#include "ss.hpp"
+#include "varint.hpp"
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+static constexpr std::string_view FILE_INDEX_HEADER = "# ninja_times files v1";
+
+// Reads the line at p, and advances p past it. Returns false if there is no complete line.
+static bool readLine(const char *&p, const char *end, std::string_view *line)
+{
+    if (p == end)
+    {
+        return false;
+    }
+    const char *lineEnd = (const char *)memchr(p, '\n', end - p);
+    if (lineEnd == nullptr)
+    {
+        return false;
+    }
+    *line = std::string_view(p, lineEnd - p);
+    p = lineEnd + 1;
+    return true;
+}
+
+// Reads a number followed by separator, and advances p past them.
+static bool readNumber(const char *&p, const char *end, char separator, uint64_t *value)
+{
+    auto result = std::from_chars(p, end, *value);
+    if (result.ec != std::errc() || result.ptr == end || *result.ptr != separator)
+    {
+        return false;
+    }
+    p = result.ptr + 1;
+    return true;
+}
+
+void FileIndex::clear()
+{
+    file_.close();
+    checkpoint_ = HistoryCheckpoint();
+    files_.clear();
+    addedNames_.clear();
+    ids_.clear();
+    lineCount_ = 0;
+}
+
+uint32_t FileIndex::find(std::string_view name) const
+{
+    if (ids_.size() != files_.size())
+    {
+        ids_.clear();
+        ids_.reserve(files_.size());
+        for (uint32_t id = 0; id < files_.size(); ++id)
+        {
+            ids_.emplace(files_[id].name, id);
+        }
+    }
+    auto it = ids_.find(name);
+    return it == ids_.end() ? NOT_FOUND : it->second;
+}
+
+std::vector<uint64_t> FileIndex::lines(uint32_t id) const
+{
+    const File &file = files_[id];
+    std::vector<uint64_t> result;
+    result.reserve(file.count);
+    uint64_t offset = 0;
+    for (std::string_view deltas : {file.deltas, std::string_view(file.addedDeltas)})
+    {
+        const uint8_t *p = (const uint8_t *)deltas.data();
+        const uint8_t *end = p + deltas.length();
+        while (p < end)
+        {
+            uint64_t delta;
+            if ((p = readVarint(p, end, &delta)) == nullptr)
+            {
+                throw std::logic_error(SS("The file index entry for " << file.name << " is not valid."));
+            }
+            offset += delta;
+            result.push_back(offset);
+        }
+    }
+    if (result.size() != file.count)
+    {
+        throw std::logic_error(SS("The file index entry for " << file.name << " is not valid."));
+    }
+    return result;
+}
+
+void FileIndex::add(std::string_view name, const std::vector<uint64_t> &lines)
+{
+    uint32_t id = find(name);
+    if (id == NOT_FOUND)
+    {
+        id = (uint32_t)files_.size();
+        files_.emplace_back().name = addedNames_.emplace_back(name);
+        ids_.emplace(files_.back().name, id);
+    }
+    File &file = files_[id];
+    for (uint64_t offset : lines)
+    {
+        writeVarint(file.addedDeltas, offset - file.last);
+        file.last = offset;
+    }
+    file.count += lines.size();
+    lineCount_ += lines.size();
+}
+
+bool FileIndex::update(const NinjaLogReader &history, size_t threads)
+{
+    std::string_view text = history.text();
+    uint64_t start = checkpoint_.resume_offset(history.file());
+    if (start == 0)
+    {
+        clear();
+    }
+    uint64_t end = HistoryCheckpoint::complete_lines_end(text, start);
+    HistoryCheckpoint checkpoint(history.file(), end);
+    if (start == end && checkpoint == checkpoint_)
+    {
+        return false;
+    }
+
+    // Each chunk's lines, grouped by file. Files are added to the index in the order in which
+    // they first appear, so that the index doesn't depend on the number of threads.
+    struct ChunkLines {
+        std::vector<std::string_view> names;
+        std::unordered_map<std::string_view, std::vector<uint64_t>> lines;
+    };
+    threads = resolve_thread_count(threads);
+    std::vector<std::string_view> chunks = NinjaLogReader::chunks(text.substr(start, end - start), threads);
+    std::vector<ChunkLines> chunkLines(chunks.size());
+    parallel_for(chunks.size(), threads,
+        [&](size_t i)
+        {
+            ChunkLines &result = chunkLines[i];
+            history.for_each(
+                chunks[i],
+                [&](const NinjaRecord &record)
+                {
+                    const char *line = record.file_name.data();
+                    while (line > chunks[i].data() && line[-1] != '\n')
+                    {
+                        --line;
+                    }
+                    auto &lines = result.lines[record.file_name];
+                    if (lines.empty())
+                    {
+                        result.names.push_back(record.file_name);
+                    }
+                    lines.push_back(line - text.data());
+                });
+        });
+    for (const ChunkLines &chunk : chunkLines)
+    {
+        for (std::string_view name : chunk.names)
+        {
+            add(name, chunk.lines.at(name));
+        }
+    }
+    checkpoint_ = checkpoint;
+    return true;
+}
+
+bool FileIndex::load(const std::string &filename)
+{
+    clear();
+    if (!std::filesystem::exists(filename))
+    {
+        return false;
+    }
+    file_.open(filename);
+
+    const char *p = file_.data();
+    const char *end = p + file_.size();
+    std::string_view line;
+    uint64_t count = 0;
+    bool valid = readLine(p, end, &line) && line == FILE_INDEX_HEADER && readLine(p, end, &line);
+    if (valid)
+    {
+        std::istringstream s{std::string(line)};
+        valid = checkpoint_.read(s) && readNumber(p, end, '\n', &count);
+    }
+    std::vector<uint64_t> deltaBytes;
+    uint64_t totalDeltaBytes = 0;
+    for (uint64_t i = 0; valid && i < count; ++i)
+    {
+        File &file = files_.emplace_back();
+        uint64_t bytes = 0;
+        valid = readNumber(p, end, ' ', &file.count) && readNumber(p, end, ' ', &file.last) &&
+                readNumber(p, end, '\t', &bytes) && readLine(p, end, &file.name);
+        deltaBytes.push_back(bytes);
+        totalDeltaBytes += bytes;
+        lineCount_ += file.count;
+    }
+    if (!valid || (uint64_t)(end - p) != totalDeltaBytes)
+    {
+        clear();
+        return false;
+    }
+    // the offsets of each file follow the directory, in the same order.
+    for (size_t i = 0; i < files_.size(); ++i)
+    {
+        files_[i].deltas = std::string_view(p, deltaBytes[i]);
+        p += deltaBytes[i];
+    }
+    return true;
+}
+
+void FileIndex::save(const std::string &filename) const
+{
+    std::string tmpFile = filename + ".$$$";
+    {
+        std::ofstream f(tmpFile, std::ios_base::binary);
+        if (!f.is_open())
+        {
+            throw std::invalid_argument(SS("Can't open file " << tmpFile));
+        }
+        f << FILE_INDEX_HEADER << '\n';
+        checkpoint_.write(f);
+        f << files_.size() << '\n';
+        for (const File &file : files_)
+        {
+            f << file.count << ' ' << file.last << ' ' << file.deltas.length() + file.addedDeltas.length() << '\t' << file.name << '\n';
+        }
+        for (const File &file : files_)
+        {
+            f.write(file.deltas.data(), file.deltas.length());
+            f.write(file.addedDeltas.data(), file.addedDeltas.length());
+        }
+        f.close();
+        if (!f)
+        {
+            throw std::invalid_argument(SS("Can't write file " << tmpFile));
+        }
+    }
+    // the old index is still mapped, but that's fine on a POSIX filesystem.
+    std::filesystem::rename(tmpFile, filename);
+}
@@ -0,0 +1,91 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "history_checkpoint.hpp"
+#include "mapped_file.hpp"
+#include "ninja_log_reader.hpp"
+
+// Index of the lines of each file in a text history (.ninja_log.history.files).
+//
+// For each file name, holds the byte offsets of the lines of its records, in history order, so
+// that the records of a few files can be read without parsing the rest of the history. Offsets
+// are stored as varints of the difference from the previous offset of the same file.
+//
+// The index file is a directory of file names, followed by the offsets of each file. It is
+// mapped into memory; only the directory is read when it is loaded, and a file's offsets are
+// decoded only if they are asked for.
+//
+// Updates parse only the lines added to the history since the index was last updated. If the
+// history has been rewritten, the index is rebuilt.
+class FileIndex {
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    FileIndex() {}
+    FileIndex(const FileIndex &) = delete;
+    FileIndex &operator=(const FileIndex &) = delete;
+
+    // Returns false if the index doesn't exist, or is not valid.
+    bool load(const std::string &filename);
+    void save(const std::string &filename) const;
+
+    // Return true if the index changed.
+    bool update(const NinjaLogReader &history, size_t threads);
+
+    size_t name_count() const { return files_.size(); }
+    std::string_view name(uint32_t id) const { return files_[id].name; }
+    // Builds a map of names on first use.
+    uint32_t find(std::string_view name) const;
+
+    // Number of records of a file, and in the whole history.
+    uint64_t line_count(uint32_t id) const { return files_[id].count; }
+    uint64_t line_count() const { return lineCount_; }
+
+    // Offsets of the lines of a file's records, ascending.
+    std::vector<uint64_t> lines(uint32_t id) const;
+
+private:
+    struct File {
+        std::string_view name;
+        uint64_t count = 0;
+        uint64_t last = 0;          // the offset that the next delta is relative to.
+        std::string_view deltas;    // in the mapped index file.
+        std::string addedDeltas;    // for lines added by update().
+    };
+
+    void clear();
+    void add(std::string_view name, const std::vector<uint64_t> &lines);
+
+    MappedFile file_;
+    HistoryCheckpoint checkpoint_;
+    std::vector<File> files_;
+    std::deque<std::string> addedNames_; // names of files added by update(). A deque, so that views of them stay valid.
+    mutable std::unordered_map<std::string_view, uint32_t> ids_;
+    uint64_t lineCount_ = 0;
+};
@@ -0,0 +1,125 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Micro-benchmark: GlobMatcher throughput for each pattern shape, with and without the
+// shape-specialized matchers.
+//
+// Syntax: glob_matcher_bench [name_count]    (default: 1000000)
+
+#include "GlobMatcher.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static std::vector<std::string> makeFileNames(size_t count)
+{
+    static const char *targets[] = {"libpipedald.dir", "jsonTest.dir", "WebServerTest.dir", "lv2.dir/sub"};
+    std::mt19937_64 random(1);
+    std::vector<std::string> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t file = random() % 20000;
+        std::string name = (file % 7 == 0) ? "third_party/CMakeFiles/" : "src/CMakeFiles/";
+        name += targets[file % 4];
+        name += "/module";
+        name += std::to_string(file % 40);
+        name += "/File";
+        name += std::to_string(file);
+        name += (file % 3 == 0) ? ".c.o" : ".cpp.o";
+        result.push_back(std::move(name));
+    }
+    return result;
+}
+
+template <typename FN>
+static double timeIt(FN &&fn)
+{
+    using clock_t = std::chrono::steady_clock;
+    auto start = clock_t::now();
+    fn();
+    return std::chrono::duration<double>(clock_t::now() - start).count();
+}
+
+static double nsPerName(const GlobMatcher &matcher, const std::vector<std::string> &names, size_t *matches)
+{
+    *matches = 0;
+    double seconds = timeIt(
+        [&]()
+        {
+            for (const auto &name : names)
+            {
+                *matches += matcher.Matches(name);
+            }
+        });
+    return seconds * 1e9 / names.size();
+}
+
+int main(int argc, const char **argv)
+{
+    size_t count = 1000000;
+    if (argc > 1)
+    {
+        count = std::stoul(argv[1]);
+    }
+    std::vector<std::string> names = makeFileNames(count);
+
+    // Each pattern, and an equivalent pattern that the classifier doesn't recognize (a one-character
+    // class in place of a literal character), which is matched by the general automaton.
+    struct Case
+    {
+        const char *shape;
+        const char *pattern;
+        const char *general;
+    };
+    const Case cases[] = {
+        {"suffix", "*.c.o", "*[.]c.o"},
+        {"prefix", "third_party/*", "[t]hird_party/*"},
+        {"substring", "*WebServer*", "*[W]ebServer*"},
+        {"exact", "src/CMakeFiles/jsonTest.dir/module5/File1245.c.o", "[s]rc/CMakeFiles/jsonTest.dir/module5/File1245.c.o"},
+        {"general", "*File1?3.cpp.o", "*File1?3.cpp.o"},
+    };
+
+    cout << setw(10) << "shape" << setw(14) << "ns/name" << setw(14) << "general" << setw(10) << "matches" << "   pattern" << endl;
+    for (const Case &c : cases)
+    {
+        size_t matches, generalMatches;
+        double ns = nsPerName(GlobMatcher(c.pattern), names, &matches);
+        double generalNs = nsPerName(GlobMatcher(c.general), names, &generalMatches);
+        if (matches != generalMatches)
+        {
+            cout << "Error: " << c.pattern << " and " << c.general << " don't match the same names." << endl;
+            return EXIT_FAILURE;
+        }
+        cout << setw(10) << c.shape
+             << setw(14) << setprecision(1) << fixed << ns
+             << setw(14) << generalNs
+             << setw(10) << matches
+             << "   " << c.pattern << endl;
+    }
+    return EXIT_SUCCESS;
+}
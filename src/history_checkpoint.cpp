@@ -0,0 +1,137 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "history_checkpoint.hpp"
+#include "mapped_file.hpp"
+#include "ss.hpp"
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+static constexpr const char *CHECKPOINT_HEADER = "# ninja_times checkpoint v1";
+
+HistoryCheckpoint::HistoryCheckpoint()
+{
+}
+
+HistoryCheckpoint::HistoryCheckpoint(const MappedFile &log, size_t offset)
+    : device_(log.device()),
+      inode_(log.inode()),
+      offset_(offset)
+{
+    std::string_view text = log.text().substr(0, offset);
+    size_t lastLine = 0;
+    if (text.length() >= 2)
+    {
+        size_t pos = text.rfind('\n', text.length() - 2);
+        lastLine = (pos == std::string_view::npos) ? 0 : pos + 1;
+    }
+    lastRecordOffset_ = lastLine;
+    lastRecordHash_ = hash(text.substr(lastLine));
+}
+
+uint64_t HistoryCheckpoint::hash(std::string_view text)
+{
+    // FNV-1a
+    uint64_t result = 0xcbf29ce484222325ULL;
+    for (char c : text)
+    {
+        result ^= (uint8_t)c;
+        result *= 0x100000001b3ULL;
+    }
+    return result;
+}
+
+size_t HistoryCheckpoint::complete_lines_end(std::string_view text, size_t start)
+{
+    size_t pos = text.rfind('\n');
+    if (pos == std::string_view::npos || pos + 1 < start)
+    {
+        return start;
+    }
+    return pos + 1;
+}
+
+size_t HistoryCheckpoint::resume_offset(const MappedFile &log) const
+{
+    if (log.device() != device_ || log.inode() != inode_ || log.size() < offset_ || lastRecordOffset_ > offset_)
+    {
+        return 0;
+    }
+    std::string_view lastRecord = log.text().substr(lastRecordOffset_, offset_ - lastRecordOffset_);
+    if (hash(lastRecord) != lastRecordHash_)
+    {
+        return 0;
+    }
+    return offset_;
+}
+
+bool HistoryCheckpoint::load(const std::string &filename)
+{
+    std::ifstream f(filename);
+    if (!f.is_open())
+    {
+        return false;
+    }
+    std::string header;
+    if (!std::getline(f, header) || header != CHECKPOINT_HEADER)
+    {
+        return false;
+    }
+    return read(f);
+}
+
+bool HistoryCheckpoint::read(std::istream &s)
+{
+    s >> device_ >> inode_ >> offset_ >> lastRecordOffset_ >> std::hex >> lastRecordHash_ >> std::dec;
+    if (s.fail())
+    {
+        *this = HistoryCheckpoint();
+        return false;
+    }
+    return true;
+}
+
+void HistoryCheckpoint::write(std::ostream &s) const
+{
+    s << device_ << '\t' << inode_ << '\t' << offset_ << '\t' << lastRecordOffset_ << '\t'
+      << std::hex << lastRecordHash_ << std::dec << '\n';
+}
+
+void HistoryCheckpoint::save(const std::string &filename) const
+{
+    std::string tmpFile = filename + ".$$$";
+    {
+        std::ofstream f(tmpFile);
+        if (!f.is_open())
+        {
+            throw std::invalid_argument(SS("Can't open file " << tmpFile));
+        }
+        f << CHECKPOINT_HEADER << '\n';
+        write(f);
+        f.close();
+        if (!f)
+        {
+            throw std::invalid_argument(SS("Can't write file " << tmpFile));
+        }
+    }
+    std::filesystem::rename(tmpFile, filename);
+}
@@ -0,0 +1,69 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+class MappedFile;
+
+// Records how much of a .ninja_log has already been merged into its history, so that the next
+// run only needs to parse records that ninja has appended since.
+//
+// The checkpoint is trusted only if the log is the same file (device and inode), has not shrunk,
+// and the record that ended at the checkpoint is unchanged. Otherwise ninja has rewritten or
+// recompacted the log, and the whole log must be merged again.
+class HistoryCheckpoint {
+public:
+    HistoryCheckpoint();
+
+    // Captures the state of a log whose complete lines up to offset have been merged.
+    HistoryCheckpoint(const MappedFile &log, size_t offset);
+
+    // Returns false if the checkpoint file doesn't exist, or is not valid.
+    bool load(const std::string &filename);
+    void save(const std::string &filename) const;
+
+    // The checkpoint's fields, as one line, for embedding in other files.
+    bool read(std::istream &s);
+    void write(std::ostream &s) const;
+
+    // The offset in log at which unmerged records start. 0 if the checkpoint doesn't apply to log.
+    size_t resume_offset(const MappedFile &log) const;
+
+    // Offset just past the last complete line of text at or after start. Partial lines are
+    // left for the next run, since ninja may still be writing them.
+    static size_t complete_lines_end(std::string_view text, size_t start);
+
+    bool operator==(const HistoryCheckpoint &other) const = default;
+
+private:
+    static uint64_t hash(std::string_view text);
+
+    uint64_t device_ = 0;
+    uint64_t inode_ = 0;
+    uint64_t offset_ = 0;
+    uint64_t lastRecordOffset_ = 0;
+    uint64_t lastRecordHash_ = 0;
+};
@@ -0,0 +1,62 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "history_retention.hpp"
+#include "ninja_log.hpp"
+#include <algorithm>
+
+void HistoryRetention::apply(std::vector<Record> &records, uint64_t now) const
+{
+    const uint64_t day = (uint64_t)std::chrono::duration_cast<ninja_clock_t::duration>(std::chrono::hours(24)).count();
+
+    // newest first.
+    std::sort(records.begin(), records.end(),
+        [](const Record &v1, const Record &v2)
+        {
+            return v1.mtime > v2.mtime;
+        });
+
+    uint64_t keepAfter = keep_days != 0 && keep_days * day < now ? now - keep_days * day : 0;
+    uint64_t downsampleBefore = downsample_days != 0 && downsample_days * day < now ? now - downsample_days * day : 0;
+    uint64_t kept = 0;
+    uint64_t lastDay = UINT64_MAX;
+    for (Record &record : records)
+    {
+        bool keep = record.mtime >= keepAfter;
+        if (keep && record.mtime < downsampleBefore)
+        {
+            keep = record.mtime / day != lastDay;
+            lastDay = record.mtime / day;
+        }
+        if (keep && keep_per_file != 0)
+        {
+            keep = kept < keep_per_file;
+        }
+        if (keep)
+        {
+            ++kept;
+        }
+        else
+        {
+            *record.keep = false;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Which records of a file's history are kept when the history is compacted.
+//
+// Records older than keep_days are dropped. Records older than downsample_days are thinned to the
+// most recent record of each day. Then at most keep_per_file of the most recent records are kept.
+// 0 disables each rule.
+struct HistoryRetention {
+    uint64_t keep_days = 0;
+    uint64_t downsample_days = 0;
+    uint64_t keep_per_file = 0;
+
+    bool is_set() const { return keep_days != 0 || downsample_days != 0 || keep_per_file != 0; }
+
+    struct Record {
+        uint64_t mtime;  // ninja_clock_t ticks since the epoch.
+        uint8_t *keep;
+    };
+
+    // Clears the keep flags of the records of one file that are not retained, as of now (in
+    // ninja_clock_t ticks since the epoch). Reorders records.
+    void apply(std::vector<Record> &records, uint64_t now) const;
+};
@@ -0,0 +1,46 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "literal_prefilter.hpp"
+
+LiteralPrefilter::LiteralPrefilter()
+{
+}
+
+LiteralPrefilter::LiteralPrefilter(const std::vector<std::string> &literals)
+    : literals_(literals)
+{
+}
+
+bool LiteralPrefilter::is_selective(std::string_view sample) const
+{
+    if (passes_all())
+    {
+        return false;
+    }
+    size_t candidateBytes = 0;
+    for_each_line(sample,
+        [&](std::string_view line)
+        {
+            candidateBytes += line.length() + 1;
+        });
+    return candidateBytes * 2 < sample.length();
+}
@@ -0,0 +1,98 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Finds the lines of a buffer that contain at least one of a set of literal strings.
+//
+// Queries use it to skip lines that can't possibly match without parsing them. The lines that it
+// passes are only candidates, which still have to be matched in full.
+class LiteralPrefilter {
+public:
+    // Passes every line.
+    LiteralPrefilter();
+    LiteralPrefilter(const std::vector<std::string> &literals);
+
+    bool passes_all() const { return literals_.empty(); }
+    const std::vector<std::string> &literals() const { return literals_; }
+
+    // Whether skipping lines is likely to pay for itself on text like sample: true if candidate
+    // lines make up less than half of it.
+    bool is_selective(std::string_view sample) const;
+
+    // Calls fn(std::string_view line) for each line of text that contains a literal. The line
+    // excludes its '\n'.
+    template <typename FN>
+    void for_each_line(std::string_view text, FN &&fn) const
+    {
+        const char *p = text.data();
+        const char *end = p + text.length();
+
+        // the next occurrence of each literal at or after p, so that each literal is only searched
+        // for again once p has passed it.
+        std::vector<const char *> hits(literals_.size(), nullptr);
+        while (p < end)
+        {
+            const char *hit = end;
+            for (size_t i = 0; i < literals_.size(); ++i)
+            {
+                if (hits[i] == nullptr || (hits[i] != end && hits[i] < p))
+                {
+                    hits[i] = find(literals_[i], p, end);
+                }
+                if (hits[i] < hit)
+                {
+                    hit = hits[i];
+                }
+            }
+            if (hit == end)
+            {
+                break;
+            }
+            const char *lineStart = hit;
+            while (lineStart > p && lineStart[-1] != '\n')
+            {
+                --lineStart;
+            }
+            const char *lineEnd = (const char *)memchr(hit, '\n', end - hit);
+            if (lineEnd == nullptr)
+            {
+                lineEnd = end;
+            }
+            fn(std::string_view(lineStart, lineEnd - lineStart));
+            p = lineEnd + 1;
+        }
+    }
+
+private:
+    static const char *find(const std::string &literal, const char *p, const char *end)
+    {
+        const void *result = memmem(p, end - p, literal.data(), literal.length());
+        return result ? (const char *)result : end;
+    }
+
+    std::vector<std::string> literals_;
+};
@@ -21,13 +21,30 @@
 // SOFTWARE.
 #include <iostream>
 #include "ninja_log.hpp"
-#include <iomanip>
 #include "CommandLineParser.hpp"
+#include "ninja_log_follower.hpp"
+#include "build_timeline.hpp"
+#include "regression_detector.hpp"
+#include "path_rollup.hpp"
+#include "ninja_log_set.hpp"
+#include "run_stats.hpp"
+#include "output_writer.hpp"
+#include <filesystem>
+#include <unistd.h>
 
 
 using namespace twoplay;
 using namespace std;
 
+// A line of a list of files: the file's build time, in seconds, and its name.
+static void writeFile(OutputWriter &out, const NinjaFile &file)
+{
+    out.write_fixed(file.duration_ms() / 1000.00, 3, 8);
+    out.put(' ');
+    out.write(file.file_name());
+    out.put('\n');
+}
+
 
 
 
@@ -46,27 +63,149 @@ int main(int argc, const char**argv)
     bool error = false;
 
     bool history = false;
+    bool compact = false;
+    bool pack = false;
+    int keepDays = 0;
+    int keepPerFile = 0;
+    int downsampleDays = 0;
+    bool follow = false;
+    bool criticalPath = false;
+    bool builds = false;
+    bool regressions = false;
+    bool summary = false;
+    std::string groupBy;
+    int depth = 0;
+    int build = 0;
+    std::string historyFormat = "auto";
     std::string filename;
-    std::string pattern = "*";
+    std::vector<std::string> paths;
+    bool perTree = false;
+    std::vector<std::string> patterns;
+    std::vector<std::string> exclusions;
+    int threads = 0;
+    int top = 0;
+    bool stats = false;
+    bool statsJson = false;
 
     try {
         CommandLineParser parser;
         parser.AddOption("-h",&help);
         parser.AddOption("--help",&help);
         parser.AddOption("--history",&history);
-        parser.AddOption("--match",&pattern);
+        parser.AddOption("--compact",&compact);
+        parser.AddOption("--pack",&pack);
+        parser.AddOption("--keep-days",&keepDays);
+        parser.AddOption("--keep-per-file",&keepPerFile);
+        parser.AddOption("--downsample-days",&downsampleDays);
+        parser.AddOption("--follow",&follow);
+        parser.AddOption("--critical-path",&criticalPath);
+        parser.AddOption("--builds",&builds);
+        parser.AddOption("--build",&build);
+        parser.AddOption("--regressions",&regressions);
+        parser.AddOption("--summary",&summary);
+        parser.AddOption("--group-by",&groupBy);
+        parser.AddOption("--depth",&depth);
+        parser.AddOption("--per-tree",&perTree);
+        parser.AddOption("--history-format",&historyFormat);
+        parser.AddOption("--match",&patterns);
+        parser.AddOption("--exclude",&exclusions);
+        parser.AddOption("--threads",&threads);
+        parser.AddOption("--top",&top);
+        parser.AddOption("--stats",&stats);
+        parser.AddOption("--stats-json",&statsJson);
 
 
         parser.Parse(argc,argv);
 
+        if (historyFormat != "auto" && historyFormat != "text" && historyFormat != "binary")
+        {
+            throw std::logic_error("--history-format must be one of: auto, text, binary.");
+        }
+        if (keepDays < 0 || keepPerFile < 0 || downsampleDays < 0)
+        {
+            throw std::logic_error("--keep-days, --keep-per-file and --downsample-days must be zero or greater.");
+        }
+        if (pack && historyFormat == "text")
+        {
+            throw std::logic_error("--pack can't be used with --history-format text.");
+        }
+        if (keepDays != 0 || keepPerFile != 0 || downsampleDays != 0 || pack)
+        {
+            // retention is applied by compaction.
+            compact = true;
+        }
+        if (threads < 0)
+        {
+            throw std::logic_error("--threads must be zero or greater.");
+        }
+        if (top < 0)
+        {
+            throw std::logic_error("--top must be zero or greater.");
+        }
+        if (follow && (history || compact))
+        {
+            throw std::logic_error("--follow can't be used with --history or --compact.");
+        }
+        if (criticalPath && (history || compact || follow))
+        {
+            throw std::logic_error("--critical-path can't be used with --history, --compact or --follow.");
+        }
+        if (build < 0)
+        {
+            throw std::logic_error("--build must be 1 or greater.");
+        }
+        if ((builds || build != 0) && (history || compact || follow || criticalPath))
+        {
+            throw std::logic_error("--builds and --build can't be used with --history, --compact, --follow or --critical-path.");
+        }
+        if (regressions && (history || follow || criticalPath || builds || build != 0))
+        {
+            throw std::logic_error("--regressions can't be used with --history, --follow, --critical-path, --builds or --build.");
+        }
+        if (summary && (follow || criticalPath || builds || build != 0 || regressions))
+        {
+            throw std::logic_error("--summary can't be used with --follow, --critical-path, --builds, --build or --regressions.");
+        }
+        if (!groupBy.empty())
+        {
+            PathRollup::parse_group_by(groupBy);
+            if (history || compact || follow || criticalPath || builds || build != 0 || regressions || summary)
+            {
+                throw std::logic_error("--group-by can only be used with --match, --exclude, --depth and --threads.");
+            }
+        }
+        if (depth < 0)
+        {
+            throw std::logic_error("--depth must be zero or greater.");
+        }
+        if (stats || statsJson)
+        {
+#ifdef NINJA_TIMES_STATS
+            RunStats::instance().enable();
+#else
+            throw std::logic_error("--stats is not available. ninja_times was built without NINJA_TIMES_STATS.");
+#endif
+        }
+
         if (parser.ArgumentCount() == 0)
         {
             help = true;
-        } else if (parser.ArgumentCount() == 1)
+        } else if (parser.ArgumentCount() == 1 && !std::filesystem::is_directory(parser.Argument(0)))
         {
             filename = parser.Argument(0);
         } else {
-            throw std::logic_error("Incorrect number of arguments.");
+            for (size_t i = 0; i < parser.ArgumentCount(); ++i)
+            {
+                paths.push_back(parser.Argument(i));
+            }
+            if (history || compact || follow || criticalPath || builds || build != 0 || regressions || summary)
+            {
+                throw std::logic_error("Only one .ninja_log can be used with --history, --compact, --follow, --critical-path, --builds, --build, --regressions or --summary.");
+            }
+        }
+        if (perTree && paths.empty())
+        {
+            throw std::logic_error("--per-tree requires more than one .ninja_log, or a directory.");
         }
     } catch (const std::exception& e)
     {
@@ -79,15 +218,71 @@ int main(int argc, const char**argv)
     {   cout << "ninja_times: Anaylyzes .ninja_log files for per-file build times." << endl;
         cout << "Copyright (c) 2023 Robin Davies." << endl;
         cout << endl;
-        cout << "Syntax: ninja_times filename [options]" << endl;
-        cout << "   filename: path of a .ninja_log file." << endl;
+        cout << "Syntax: ninja_times filename... [options]" << endl;
+        cout << "   filename: path of a .ninja_log file, or of a directory that is searched" << endl;
+        cout << "             for build trees containing .ninja_log files. If there is more" << endl;
+        cout << "             than one log, file names are prefixed by their build tree." << endl;
         cout << "Options:" << endl;
         cout << "   -h, --help Display this message.:" << endl;
         cout << "   --history  Display history of file build times." << endl;
+        cout << "   --compact  Rewrite the history file, removing duplicate records." << endl;
+        cout << "   --pack     Compact the binary history into a packed encoding, about half" << endl;
+        cout << "              the size, that new records are then also appended in. Queries" << endl;
+        cout << "              of a packed history are several times slower. --compact without" << endl;
+        cout << "              --pack rewrites it unpacked." << endl;
+        cout << "   --keep-days N" << endl;
+        cout << "              Compact the history, dropping records older than N days." << endl;
+        cout << "   --downsample-days N" << endl;
+        cout << "              Compact the history, keeping only the most recent record of" << endl;
+        cout << "              each file for each day, for records older than N days." << endl;
+        cout << "   --keep-per-file N" << endl;
+        cout << "              Compact the history, keeping only the N most recent records" << endl;
+        cout << "              of each file." << endl;
+        cout << "   --summary  Display the history of each file's build times as a count," << endl;
+        cout << "              minimum, median, 90th and 99th percentile, and maximum." << endl;
+        cout << "   --history-format [auto|text|binary]" << endl;
+        cout << "              Format of the history file. binary keeps the history in " << endl;
+        cout << "              .ninja_log.history.bin, converting the text history on first" << endl;
+        cout << "              use. auto (the default) uses the binary history if it exists." << endl;
         cout << "   --match [pattern]" << endl;
         cout << "              A glob pattern that selects which files will be displayed." << endl;
         cout << "              ? matches a character. * matches zero or more characters. " << endl;
         cout << "              [abc] matches 'a', 'b' or 'c' [!abc] matches anything but." << endl;
+        cout << "              May be repeated; files that match any pattern are displayed." << endl;
+        cout << "   --exclude [pattern]" << endl;
+        cout << "              A glob pattern for files that will not be displayed, even if " << endl;
+        cout << "              they match a --match pattern. May be repeated." << endl;
+        cout << "   --top N    Display only the N slowest files. Not used with --history." << endl;
+        cout << "   --follow   Keep displaying the slowest files (20, unless --top is given)" << endl;
+        cout << "              while a build is running, updating the display as ninja" << endl;
+        cout << "              adds records to the log. Linux only." << endl;
+        cout << "   --critical-path" << endl;
+        cout << "              Analyze the most recent build: concurrency, idle core time, " << endl;
+        cout << "              and the chain of edges that determined its wall time." << endl;
+        cout << "   --builds   List the builds in the history: when each finished, its edge" << endl;
+        cout << "              count, wall time, total edge time, and its slowest file." << endl;
+        cout << "   --build N  Display the slowest files (20, unless --top is given) of" << endl;
+        cout << "              build N of the --builds list." << endl;
+        cout << "   --regressions" << endl;
+        cout << "              List files whose last 3 build times are significantly slower" << endl;
+        cout << "              than their median build time in the history, largest" << endl;
+        cout << "              slowdown first." << endl;
+        cout << "   --group-by [dir|target|ext]" << endl;
+        cout << "              Display total build times as a tree of directories, of CMake" << endl;
+        cout << "              targets (CMakeFiles/<target>.dir/) and the directories in them, " << endl;
+        cout << "              or of file extensions and directories." << endl;
+        cout << "   --depth N  Limit the --group-by tree to N levels." << endl;
+        cout << "   --per-tree Display the files of each build tree separately, instead of" << endl;
+        cout << "              combining the files of all trees. With --group-by, each" << endl;
+        cout << "              tree is rolled up separately." << endl;
+        cout << "   --threads N" << endl;
+        cout << "              Number of threads used to parse logs. 0 (the default) " << endl;
+        cout << "              uses one thread per CPU core." << endl;
+        cout << "   --stats    Display the time taken by each phase of the run, counts of" << endl;
+        cout << "              the records and bytes processed, and peak memory use, on" << endl;
+        cout << "              stderr." << endl;
+        cout << "   --stats-json" << endl;
+        cout << "              Display the same statistics as JSON, on stderr." << endl;
         cout << endl;
         cout << "ninja_times analyzes file build times in .ninja_log files." << endl;
         cout << endl;
@@ -96,7 +291,8 @@ int main(int argc, const char**argv)
         cout << "files that match are displayed. " << endl;
         cout << endl;
         cout << "The --history option allows you to display the history of build times " << endl;
-        cout << "for one or more files over time." << endl;
+        cout << "for one or more files over time. New build times are appended to " << endl;
+        cout << "a .ninja_log.history file each time the history is displayed." << endl;
         cout << endl;
         cout << "Examples:" << endl;
         cout << "     # display build times for all files in a project." << endl;
@@ -105,29 +301,229 @@ int main(int argc, const char**argv)
         cout << "     # display recent build times for the file PiPedalModel.ccp.o" << endl;
         cout << "     ninja_times build/.ninja_log --match PiPedalModel.cpp.o --history" << endl;
         cout << endl;
+        cout << "     # keep a year of history, with daily samples after the first 90 days." << endl;
+        cout << "     ninja_times build/.ninja_log --keep-days 365 --downsample-days 90" << endl;
+        cout << endl;
+        cout << "     # display percentiles of the build times of all C++ files." << endl;
+        cout << "     ninja_times build/.ninja_log --match '*.cpp.o' --summary" << endl;
+        cout << endl;
+        cout << "     # display the total build time of each CMake target." << endl;
+        cout << "     ninja_times build/.ninja_log --group-by target --depth 1" << endl;
+        cout << endl;
+        cout << "     # display the 20 slowest files in all build trees under ~/src." << endl;
+        cout << "     ninja_times ~/src --top 20" << endl;
+        cout << endl;
+        cout << "     # display the 20 slowest files." << endl;
+        cout << "     ninja_times build/.ninja_log --top 20" << endl;
+        cout << endl;
+        cout << "     # find the edges that determined the wall time of the last build." << endl;
+        cout << "     ninja_times build/.ninja_log --critical-path" << endl;
+        cout << endl;
+        cout << "     # list past builds, then display the slowest files of build 12." << endl;
+        cout << "     ninja_times build/.ninja_log --builds" << endl;
+        cout << "     ninja_times build/.ninja_log --build 12" << endl;
+        cout << endl;
+        cout << "     # in CI: list the 10 files whose build times have grown the most." << endl;
+        cout << "     ninja_times build/.ninja_log --regressions --top 10" << endl;
+        cout << endl;
+        cout << "     # watch the slowest files while a build is running." << endl;
+        cout << "     ninja_times build/.ninja_log --follow" << endl;
+        cout << endl;
+        cout << "     # display build times for C++ files, except third-party and test files." << endl;
+        cout << "     ninja_times build/.ninja_log --match '*.cpp.o' --exclude third_party --exclude '*test*'" << endl;
+        cout << endl;
 
         return error? EXIT_FAILURE: EXIT_SUCCESS;
     }
 
+    HistoryFormat format = historyFormat == "text" ? HistoryFormat::Text
+                           : historyFormat == "binary" ? HistoryFormat::Binary
+                                                       : HistoryFormat::Auto;
+    HistoryRetention retention;
+    retention.keep_days = keepDays;
+    retention.keep_per_file = keepPerFile;
+    retention.downsample_days = downsampleDays;
     try {
-        if (history)
+#ifdef NINJA_TIMES_STATS
+        auto runStart = RunStats::clock_t::now();
+#endif
+        GlobMatcher matcher(patterns, exclusions);
+
+        if (!paths.empty())
+        {
+            NinjaLogSet logs;
+            logs.set_threads(threads);
+            logs.set_top(groupBy.empty() ? top : 0);
+            logs.load(paths,matcher);
+
+            STATS_TIMER(outputTimer, "output");
+            OutputWriter out(cout);
+            if (!groupBy.empty() && perTree)
+            {
+                for (size_t i = 0; i < logs.log_count(); ++i)
+                {
+                    PathRollup rollup(PathRollup::parse_group_by(groupBy));
+                    rollup.set_depth(depth);
+                    for (const auto&file : logs.log(i).files())
+                    {
+                        rollup.add(file.file_name(), file.duration_ms());
+                    }
+                    cout << logs.filename(i) << '\n' << rollup << '\n';
+                }
+            } else if (!groupBy.empty())
+            {
+                PathRollup rollup(PathRollup::parse_group_by(groupBy));
+                rollup.set_depth(depth);
+                for (const auto&file : logs.files(0))
+                {
+                    rollup.add(logs.tree(file.log) + "/" + file.file->file_name(), file.file->duration_ms());
+                }
+                cout << rollup;
+            } else if (perTree)
+            {
+                for (size_t i = 0; i < logs.log_count(); ++i)
+                {
+                    out.write(logs.filename(i));
+                    out.put('\n');
+                    for (const auto&file : logs.log(i).files())
+                    {
+                        writeFile(out, file);
+                    }
+                    out.put('\n');
+                }
+            } else {
+                for (const auto&file : logs.files(top))
+                {
+                    out.write_fixed(file.file->duration_ms() / 1000.00, 3, 8);
+                    out.put(' ');
+                    out.write(logs.tree(file.log));
+                    out.put('/');
+                    out.write(file.file->file_name());
+                    out.put('\n');
+                }
+            }
+            out.flush();
+            cout.flush();
+        } else if (builds || build != 0)
+        {
+            NinjaBuilds ninjaBuilds;
+            ninjaBuilds.set_threads(threads);
+            ninjaBuilds.set_format(format);
+            ninjaBuilds.load(filename);
+            STATS_TIMER(outputTimer, "output");
+            if (build == 0)
+            {
+                cout << ninjaBuilds;
+            } else {
+                OutputWriter out(cout);
+                for (const auto&file : ninjaBuilds.build_files(build, top != 0 ? top : 20))
+                {
+                    writeFile(out, file);
+                }
+            }
+            cout.flush();
+        } else if (regressions)
         {
             NinjaHistory history;
-            history.load(filename,pattern);
+            history.set_threads(threads);
+            history.set_compact(compact);
+            history.set_retention(retention);
+            history.set_pack(pack);
+            history.set_format(format);
+            history.load(filename,matcher);
+
+            RegressionDetector detector;
+            detector.set_threads(threads);
+            detector.set_top(top);
+            STATS_TIMER(timer, "regressions.analyze");
+            detector.analyze(history);
+            STATS_NEXT(timer, "output");
+            cout << detector;
+            cout.flush();
+        } else if (!groupBy.empty())
+        {
+            NinjaLog log;
+            log.set_threads(threads);
+            log.load(filename,matcher);
 
+            STATS_TIMER(timer, "rollup");
+            PathRollup rollup(PathRollup::parse_group_by(groupBy));
+            rollup.set_depth(depth);
+            for (const auto&file : log.files())
+            {
+                rollup.add(file.file_name(), file.duration_ms());
+            }
+            STATS_NEXT(timer, "output");
+            cout << rollup;
+            cout.flush();
+        } else if (criticalPath)
+        {
+            BuildTimeline timeline;
+            timeline.set_threads(threads);
+            timeline.load(filename);
+            cout << timeline;
+            cout.flush();
+        } else if (follow)
+        {
+            NinjaLogFollower follower(filename, matcher);
+            follower.set_top(top != 0 ? top : 20);
+            follower.run(cout, isatty(STDOUT_FILENO));
+        } else if (compact && !history && !summary)
+        {
+            NinjaHistory history;
+            history.set_threads(threads);
+            history.set_compact(true);
+            history.set_retention(retention);
+            history.set_pack(pack);
+            history.set_format(format);
+            history.load(filename,GlobMatcher());
+
+            cout << "Compacted history of " << filename << ": " << history.record_count() << " records." << endl;
+        } else if (history || summary)
+        {
+            NinjaHistory history;
+            history.set_threads(threads);
+            history.set_compact(compact);
+            history.set_retention(retention);
+            history.set_pack(pack);
+            history.set_format(format);
+            history.set_summary(summary);
+            history.load(filename,matcher);
+
+            STATS_TIMER(outputTimer, "output");
             cout << history;
             cout << endl;
 
         } else {
 
             NinjaLog log;
-            log.load(filename,pattern);
+            log.set_threads(threads);
+            log.set_top(top);
+            log.load(filename,matcher);
 
+            STATS_TIMER(outputTimer, "output");
+            OutputWriter out(cout);
             for (const auto&file : log.files())
             {
-                cout << setw(8) << setprecision(3) << fixed << (file.duration_ms() / 1000.00) << " " << file.file_name() << endl;
+                writeFile(out, file);
+            }
+            out.flush();
+            cout.flush();
+        }
+
+#ifdef NINJA_TIMES_STATS
+        if (RunStats::instance().enabled())
+        {
+            double totalSeconds = std::chrono::duration<double>(RunStats::clock_t::now() - runStart).count();
+            if (statsJson)
+            {
+                RunStats::instance().write_json(cerr, totalSeconds);
+            } else {
+                cerr << '\n';
+                RunStats::instance().write(cerr, totalSeconds);
             }
         }
+#endif
     } catch (const std::exception &e)
     {
         cout << "Error: " << e.what() << endl;
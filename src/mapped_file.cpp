@@ -0,0 +1,161 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "mapped_file.hpp"
+#include "ss.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(const std::string &filename)
+{
+    open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        std::swap(isOpen_, other.isOpen_);
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(device_, other.device_);
+        std::swap(inode_, other.inode_);
+        std::swap(mapping_, other.mapping_);
+        std::swap(mappingSize_, other.mappingSize_);
+        std::swap(fd_, other.fd_);
+    }
+    return *this;
+}
+
+void MappedFile::open(const std::string &filename, size_t capacity)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        throw std::invalid_argument(SS("Can't open file " << filename));
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        ::close(fd);
+        throw std::invalid_argument(SS("Can't read file " << filename));
+    }
+    size_t size = (size_t)st.st_size;
+    size_t mappingSize = std::max(size, capacity);
+    if (mappingSize != 0)
+    {
+        // a shared mapping, so that data appended to the file appears in it. Pages past the end of
+        // the file are never touched.
+        void *mapping = mmap(nullptr, mappingSize, PROT_READ, capacity != 0 ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::invalid_argument(SS("Can't map file " << filename));
+        }
+        madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+        mapping_ = mapping;
+        mappingSize_ = mappingSize;
+        data_ = (const char *)mapping;
+    }
+    if (capacity != 0)
+    {
+        fd_ = fd;
+    }
+    else
+    {
+        ::close(fd); // the mapping keeps its own reference to the file.
+    }
+    size_ = size;
+    device_ = (uint64_t)st.st_dev;
+    inode_ = (uint64_t)st.st_ino;
+    isOpen_ = true;
+}
+
+void MappedFile::release(std::string_view range) const
+{
+    static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+    // only whole pages that lie entirely within the range.
+    uintptr_t start = ((uintptr_t)range.data() + pageSize - 1) & ~(uintptr_t)(pageSize - 1);
+    uintptr_t end = ((uintptr_t)range.data() + range.length()) & ~(uintptr_t)(pageSize - 1);
+    if (mapping_ != nullptr && end > start)
+    {
+        madvise((void *)start, end - start, MADV_DONTNEED);
+    }
+}
+
+bool MappedFile::refresh()
+{
+    struct stat st;
+    if (fd_ == -1 || fstat(fd_, &st) == -1)
+    {
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size < size_ || size > mappingSize_)
+    {
+        return false;
+    }
+    size_ = size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapping_ != nullptr)
+    {
+        munmap(mapping_, mappingSize_);
+    }
+    if (fd_ != -1)
+    {
+        ::close(fd_);
+    }
+    mapping_ = nullptr;
+    mappingSize_ = 0;
+    fd_ = -1;
+    data_ = nullptr;
+    size_ = 0;
+    device_ = 0;
+    inode_ = 0;
+    isOpen_ = false;
+}
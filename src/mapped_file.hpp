@@ -0,0 +1,76 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// A read-only memory mapping of an entire file.
+//
+// Views returned by text() remain valid until the MappedFile is closed or destroyed.
+//
+// A file that is being appended to can be opened with a capacity: it is then mapped with room to grow
+// to that size, and kept open, so that refresh() can pick up appended data without mapping it again.
+class MappedFile {
+public:
+    MappedFile();
+    MappedFile(const std::string &filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    void open(const std::string &filename, size_t capacity = 0);
+    void close();
+
+    // Extends text() to include data appended to the file since it was opened, or last refreshed.
+    // Returns false if the file was not opened with a capacity, or has outgrown it, or has shrunk;
+    // it must then be opened again.
+    bool refresh();
+
+    bool is_open() const { return isOpen_; }
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view text() const { return std::string_view(data_, size_); }
+
+    // Advises the kernel that a range of the mapping won't be needed again soon, so that its pages
+    // can be dropped from memory. They are read back from the file if they are accessed again.
+    void release(std::string_view range) const;
+
+    // Identity of the file that was mapped.
+    uint64_t device() const { return device_; }
+    uint64_t inode() const { return inode_; }
+
+private:
+    bool isOpen_ = false;
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    uint64_t device_ = 0;
+    uint64_t inode_ = 0;
+    void *mapping_ = nullptr;
+    size_t mappingSize_ = 0;
+    int fd_ = -1; // kept open only if the file was opened with a capacity.
+};
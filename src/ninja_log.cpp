@@ -26,16 +26,33 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
-#include <iomanip>
 #include "GlobMatcher.hpp"
 #include <filesystem>
 #include <unordered_set>
+#include <unordered_map>
+#include <memory>
+#include "parallel.hpp"
+#include "run_stats.hpp"
+#include "history_checkpoint.hpp"
+#include "binary_history.hpp"
+#include "file_index.hpp"
+#include "output_writer.hpp"
+#include "string_interner.hpp"
+#include <functional>
+#include <cstring>
 
 using namespace std;
 
+// Beyond this, searching for each literal separately costs more than parsing every line.
+static constexpr size_t MAX_PREFILTER_LITERALS = 16;
+
+// Reading scattered lines costs more per line than parsing whole chunks, so the file index is used
+// only if it selects at most 1/INDEX_SELECTIVITY of the history's lines.
+static constexpr uint64_t INDEX_SELECTIVITY = 8;
+
 struct FileKey {
-    std::string name;
-    int64_t time;
+    std::string_view name;
+    uint64_t time;
     bool operator==(const FileKey&other) const { 
         return time == other.time && name == other.name;
     }
@@ -46,227 +63,1031 @@ struct std::hash<FileKey>
 {
     std::size_t operator()(FileKey const& v) const noexcept
     {
-        std::size_t h1 = std::hash<std::string>{}(v.name);
-        std::size_t h2 = std::hash<int64_t>{}(v.time);
+        std::size_t h1 = std::hash<std::string_view>{}(v.name);
+        std::size_t h2 = std::hash<uint64_t>{}(v.time);
         return h1 * (h2 *0x010013UL); 
     }
 };
 
-void NinjaHistory::load(const std::string&filename, const std::string&pattern)
+struct FileIdKey {
+    uint32_t fileId;
+    uint64_t time;
+    bool operator==(const FileIdKey&other) const { 
+        return time == other.time && fileId == other.fileId;
+    }
+};
+
+template<>
+struct std::hash<FileIdKey>
 {
-    GlobMatcher matcher { pattern};
+    std::size_t operator()(FileIdKey const& v) const noexcept
+    {
+        return std::hash<uint64_t>{}(v.time ^ ((uint64_t)v.fileId << 40));
+    }
+};
 
-    std::string line;
+// Compact form of a history or log record, as held in memory for every record of the history.
+//
+// The file name is interned; the extra field is left in the mapped file, since it is only
+// needed when records are written.
+struct HistoryRecord {
+    const char *extra;
+    uint64_t mtime;
+    uint32_t start_time_ms;
+    uint32_t end_time_ms;
+    uint32_t file_id;
+};
 
-    std::string history = filename + ".history";
-    std::vector<NinjaFile> allFiles;
+// History records hold start and end times as 32-bit milliseconds from the start of a build (about
+// 49 days). A record with later times is reported as a format error, rather than stored truncated.
+static void checkRecordTimes(const NinjaLogReader &reader, const NinjaRecord &record)
+{
+    if (record.start_time_ms > UINT32_MAX || record.end_time_ms > UINT32_MAX)
+    {
+        throw_ninja_format_error(reader.filename(), reader.text().data(), record.file_name.data());
+    }
+}
+
+// A newline-aligned chunk of the history or log, parsed on its own worker thread.
+//
+// Records are distributed into shards by file ID, so that deduplication and grouping
+// by file can also run in parallel, one worker per shard, without locking.
+struct HistoryChunk {
+    const NinjaLogReader *reader = nullptr;
+    std::string_view text;
+    bool fromHistory = false;
+    // If not empty, only the lines that start at these offsets of text are parsed.
+    std::vector<uint64_t> lines = {};
 
-    std::unordered_set<FileKey> existingRecords{1000};
+    std::vector<HistoryRecord> records = {};
+    std::vector<uint8_t> keep = {};
+    std::vector<std::vector<uint32_t>> shards = {};
 
+    // Only lines that pass prefilter are parsed.
+    //
+    // If releasePages is set, pages of the mapped file are dropped from memory once they have been
+    // parsed. The extra fields of the chunk's records are then read back from disk if they are used.
+    void parse(StringInterner &interner, size_t shardCount, const LiteralPrefilter &prefilter, bool releasePages)
+    {
+        constexpr size_t RELEASE_INTERVAL = 16 * 1024 * 1024;
+
+        shards.resize(shardCount);
+        auto add = [&](const NinjaRecord &record)
+        {
+            checkRecordTimes(*reader, record);
+            uint32_t index = (uint32_t)records.size();
+            uint32_t fileId = interner.intern(record.file_name);
+            records.push_back(HistoryRecord{
+                record.extra.data(),
+                record.mtime,
+                (uint32_t)record.start_time_ms,
+                (uint32_t)record.end_time_ms,
+                fileId});
+            shards[fileId % shardCount].push_back(index);
+        };
+        if (!lines.empty())
+        {
+            const char *end = text.data() + text.length();
+            NinjaRecord record;
+            for (uint64_t offset : lines)
+            {
+                if (offset >= text.length() || parse_ninja_record(text.data() + offset, end, &record) == nullptr)
+                {
+                    throw_ninja_format_error(reader->filename(), reader->text().data(), text.data() + std::min<uint64_t>(offset, text.length()));
+                }
+                add(record);
+            }
+            keep.resize(records.size());
+            return;
+        }
+
+        const char *releasedTo = text.data();
+        reader->for_each(
+            text,
+            prefilter,
+            [&](const NinjaRecord &record)
+            {
+                add(record);
+
+                if (releasePages && (size_t)(record.extra.data() - releasedTo) > RELEASE_INTERVAL)
+                {
+                    reader->file().release(std::string_view(releasedTo, record.extra.data() - releasedTo));
+                    releasedTo = record.extra.data();
+                }
+            });
+        if (releasePages)
+        {
+            reader->file().release(std::string_view(releasedTo, text.data() + text.length() - releasedTo));
+        }
+        keep.resize(records.size());
+    }
+};
+
+static void addChunks(std::vector<HistoryChunk> &chunks, const NinjaLogReader &reader, std::string_view text, size_t threads, bool fromHistory)
+{
+    for (std::string_view chunk : NinjaLogReader::chunks(text, threads))
+    {
+        chunks.push_back(HistoryChunk{&reader, chunk, fromHistory});
+    }
+}
+
+static void writeRecords(std::ostream &f, const std::vector<HistoryChunk> &chunks, bool fromHistory, const StringInterner &fileNames)
+{
+    for (const auto &chunk : chunks)
+    {
+        if (chunk.fromHistory != fromHistory)
+        {
+            continue;
+        }
+        const char *textEnd = chunk.text.data() + chunk.text.length();
+        for (size_t i = 0; i < chunk.records.size(); ++i)
+        {
+            if (chunk.keep[i])
+            {
+                const HistoryRecord &record = chunk.records[i];
+                const char *extraEnd = (const char *)memchr(record.extra, '\n', textEnd - record.extra);
+                if (extraEnd == nullptr)
+                {
+                    extraEnd = textEnd;
+                }
+                f << record.start_time_ms
+                  << '\t' << record.end_time_ms
+                  << '\t' << record.mtime
+                  << '\t' << fileNames.str(record.file_id)
+                  << '\t' << std::string_view(record.extra, extraEnd - record.extra)
+                  << '\n';
+            }
+        }
+    }
+}
+
+// Matches each distinct file name once, rather than once per record.
+static std::vector<uint8_t> matchFileNames(const GlobMatcher &matcher, size_t fileCount, size_t threads, const std::function<std::string_view(uint32_t)> &fileName)
+{
+    std::vector<uint8_t> matched(fileCount);
+    parallel_for(threads, threads,
+        [&](size_t thread)
+        {
+            for (size_t i = thread; i < fileCount; i += threads)
+            {
+                matched[i] = matcher.Matches(fileName((uint32_t)i));
+            }
+        });
+    return matched;
+}
+
+static HistoryFormat resolveFormat(const std::string &filename, HistoryFormat format)
+{
+    if (format == HistoryFormat::Auto)
+    {
+        format = std::filesystem::exists(filename + ".history.bin") ? HistoryFormat::Binary : HistoryFormat::Text;
+    }
+    return format;
+}
+
+void NinjaHistory::load(const std::string&filename, const GlobMatcher&matcher)
+{
+    if (resolveFormat(filename, format_) == HistoryFormat::Binary)
+    {
+        load_binary(filename, matcher);
+    }
+    else
+    {
+        if (pack_)
+        {
+            throw std::logic_error("Only a binary history can be packed. Use --history-format binary.");
+        }
+        load_text(filename, matcher);
+    }
+}
+
+void NinjaHistory::load_text(const std::string&filename, const GlobMatcher&matcher)
+{
+    size_t threads = resolve_thread_count(threads_);
+    size_t shardCount = threads;
+
+    std::string history = filename + ".history";
+    std::string checkpointFile = history + ".checkpoint";
+
+    STATS_TIMER(timer, "history.read");
+    // Records refer to the mapped files, which must outlive the chunks.
+    std::unique_ptr<NinjaLogReader> historyReader;
     if (std::filesystem::exists(history))
     {
-        ifstream f(history);
-        if (!f.is_open())
+        historyReader = std::make_unique<NinjaLogReader>(history);
+    }
+    NinjaLogReader logReader(filename);
+    logReader.check_header();
+
+    // Only the part of the log that was appended since the last run needs to be merged.
+    HistoryCheckpoint checkpoint;
+    size_t logStart = 0;
+    if (historyReader && !compact_ && checkpoint.load(checkpointFile))
+    {
+        logStart = checkpoint.resume_offset(logReader.file());
+    }
+    size_t logEnd = HistoryCheckpoint::complete_lines_end(logReader.text(), logStart);
+    std::string_view newLogText = logReader.text().substr(logStart, logEnd - logStart);
+
+    std::vector<HistoryChunk> chunks;
+    if (historyReader)
+    {
+        addChunks(chunks, *historyReader, historyReader->text(), threads, true);
+    }
+    addChunks(chunks, logReader, newLogText, threads, false);
+
+    std::vector<size_t> logChunks, historyChunks;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        (chunks[i].fromHistory ? historyChunks : logChunks).push_back(i);
+    }
+
+    STATS_COUNT("log.bytes", newLogText.length());
+    STATS_COUNT("history.bytes", historyReader ? historyReader->text().length() : 0);
+
+    STATS_NEXT(timer, "history.parse_log");
+    // New log records are all merged into the history, so they are parsed in full, first.
+    StringInterner fileNames;
+    parallel_for(logChunks.size(), threads,
+        [&](size_t i)
         {
-            throw std::invalid_argument(SS("Can't open file" << history));
+            chunks[logChunks[i]].parse(fileNames, shardCount, LiteralPrefilter(), false);
+        });
+
+    // Unless compacting, history records are never written, so a history line only needs to be parsed
+    // if it might match the query, or might duplicate a new log record (which has the same file name).
+    LiteralPrefilter historyPrefilter;
+    if (!compact_ && matcher.MatchesNothing())
+    {
+        // only merging: the history is probed for duplicates of new log records, and nothing else.
+        if (fileNames.size() == 0)
+        {
+            std::erase_if(chunks, [](const HistoryChunk &chunk) { return chunk.fromHistory; });
+            historyChunks.clear();
         }
-        while (std::getline(f,line))
+        else if (fileNames.size() <= MAX_PREFILTER_LITERALS)
         {
-            if (line.length() != 0 && !line.starts_with('#'))
+            std::vector<std::string> literals;
+            for (uint32_t fileId : fileNames.sorted_ids())
             {
-                NinjaFile file{line};
-                allFiles.push_back(file);
-                FileKey key {
-                    file.file_name(),
-                    file.time().time_since_epoch().count()
-                };
-                existingRecords.insert(key);
+                literals.push_back(std::string(fileNames.str(fileId)));
             }
+            historyPrefilter = LiteralPrefilter(literals);
+        }
+    }
+    else if (!compact_ && !matcher.RequiredLiterals().empty() && matcher.RequiredLiterals().size() + fileNames.size() <= MAX_PREFILTER_LITERALS)
+    {
+        std::vector<std::string> literals = matcher.RequiredLiterals();
+        for (uint32_t fileId : fileNames.sorted_ids())
+        {
+            literals.push_back(std::string(fileNames.str(fileId)));
         }
+        historyPrefilter = LiteralPrefilter(literals);
     }
 
-    bool recordAdded = false;
+    // The file index selects the history lines of files that might match the query, or might duplicate
+    // a new log record. If there are few enough, only those lines are read.
+    std::string indexFile = history + ".files";
+    FileIndex fileIndex;
+    bool indexChanged = false;
+    if (historyReader && !compact_ && !historyChunks.empty())
     {
-        ifstream f;
-        f.open(filename);
-        if (!f.is_open()) 
+        STATS_NEXT(timer, "history.index");
+        fileIndex.load(indexFile);
+        indexChanged = fileIndex.update(*historyReader, threads);
+
+        std::vector<uint8_t> selected = matchFileNames(matcher, fileIndex.name_count(), threads,
+            [&](uint32_t id)
+            {
+                return fileIndex.name(id);
+            });
+        for (uint32_t fileId = 0; fileId < fileNames.max_id(); ++fileId)
         {
-            throw std::invalid_argument(SS("Can't open file " << filename));
+            uint32_t id = fileNames.is_valid(fileId) ? fileIndex.find(fileNames.str(fileId)) : FileIndex::NOT_FOUND;
+            if (id != FileIndex::NOT_FOUND)
+            {
+                selected[id] = true;
+            }
         }
-        if (!std::getline(f,line))
+        uint64_t lineCount = 0;
+        for (uint32_t id = 0; id < selected.size(); ++id)
         {
-            throw std::invalid_argument("Empty log file.");
+            lineCount += selected[id] ? fileIndex.line_count(id) : 0;
         }
+        if (lineCount <= fileIndex.line_count() / INDEX_SELECTIVITY)
         {
-            if (line != "# ninja log v5")
+            std::vector<uint64_t> lines;
+            lines.reserve(lineCount);
+            for (uint32_t id = 0; id < selected.size(); ++id)
             {
-                if (line.starts_with("# ninja log"))
+                if (selected[id])
                 {
-                    throw std::invalid_argument("Invalid ninja log version. Expecting: '# ninja log v5'");
-                } else {
-                    throw std::invalid_argument("Not a valid ninja file file.. Expecting: '# ninja log v5'");
+                    std::vector<uint64_t> fileLines = fileIndex.lines(id);
+                    lines.insert(lines.end(), fileLines.begin(), fileLines.end());
                 }
             }
+            // in history order, so that the first occurrence of a record is still the one that is kept.
+            std::sort(lines.begin(), lines.end());
+
+            std::vector<HistoryChunk> indexedChunks;
+            size_t chunkCount = std::min(threads, lines.size() / 1024 + 1);
+            for (size_t i = 0; i < chunkCount && !lines.empty(); ++i)
+            {
+                indexedChunks.push_back(HistoryChunk{historyReader.get(), historyReader->text(), true,
+                    std::vector<uint64_t>(lines.begin() + lines.size() * i / chunkCount, lines.begin() + lines.size() * (i + 1) / chunkCount)});
+            }
+            STATS_COUNT("history.indexed_lines", lines.size());
+            std::erase_if(chunks, [](const HistoryChunk &chunk) { return chunk.fromHistory; });
+            chunks.insert(chunks.begin(), std::make_move_iterator(indexedChunks.begin()), std::make_move_iterator(indexedChunks.end()));
+            historyChunks.clear();
+            for (size_t i = 0; i < indexedChunks.size(); ++i)
+            {
+                historyChunks.push_back(i);
+            }
         }
-        while (std::getline(f,line))
+    }
+    STATS_NEXT(timer, "history.parse_history");
+    parallel_for(historyChunks.size(), threads,
+        [&](size_t i)
+        {
+            // Unless compacting, the file names of history records are interned, so the history
+            // doesn't need to stay in memory.
+            chunks[historyChunks[i]].parse(fileNames, shardCount, historyPrefilter, !compact_);
+        });
+
+    STATS_NEXT(timer, "history.match");
+    uint32_t fileCount = fileNames.max_id();
+    std::vector<uint8_t> matched = matchFileNames(matcher, fileCount, threads,
+        [&](uint32_t fileId)
+        {
+            return fileNames.is_valid(fileId) ? fileNames.str(fileId) : std::string_view();
+        });
+
+    uint64_t now = (uint64_t)ninja_clock_t::now().time_since_epoch().count();
+
+    STATS_NEXT(timer, "history.dedup");
+    // Each shard sees its records in file order, so the first occurrence of a record is the one that is kept.
+    std::vector<std::vector<NinjaFileHistory>> shardHistories(shardCount);
+    std::vector<std::vector<NinjaFileSummary>> shardSummaries(shardCount);
+    std::vector<int32_t> historyIndex(fileCount, -1); // each shard uses only the entries for its own files.
+    parallel_for(shardCount, threads,
+        [&](size_t shard)
         {
-            if (line.length() != 0 && !line.starts_with('#'))
+            if (compact_)
+            {
+                std::unordered_set<FileIdKey> existingRecords{1000};
+                for (auto &chunk : chunks)
+                {
+                    for (uint32_t index : chunk.shards[shard])
+                    {
+                        const HistoryRecord &record = chunk.records[index];
+                        chunk.keep[index] = existingRecords.insert(FileIdKey{record.file_id, record.mtime}).second;
+                    }
+                }
+                if (retention_.is_set())
+                {
+                    std::unordered_map<uint32_t, std::vector<HistoryRetention::Record>> fileRecords;
+                    for (auto &chunk : chunks)
+                    {
+                        for (uint32_t index : chunk.shards[shard])
+                        {
+                            if (chunk.keep[index])
+                            {
+                                fileRecords[chunk.records[index].file_id].push_back(HistoryRetention::Record{chunk.records[index].mtime, &chunk.keep[index]});
+                            }
+                        }
+                    }
+                    for (auto &entry : fileRecords)
+                    {
+                        retention_.apply(entry.second, now);
+                    }
+                }
+            }
+            else
+            {
+                // The history is never rewritten, so its records are all kept. Only new log records
+                // are indexed; the (much larger) history is just probed for duplicates of them.
+                std::unordered_map<FileIdKey, uint8_t *> newRecords;
+                for (auto &chunk : chunks)
+                {
+                    if (chunk.fromHistory)
+                    {
+                        continue;
+                    }
+                    for (uint32_t index : chunk.shards[shard])
+                    {
+                        const HistoryRecord &record = chunk.records[index];
+                        chunk.keep[index] = newRecords.emplace(FileIdKey{record.file_id, record.mtime}, &chunk.keep[index]).second;
+                    }
+                }
+                for (auto &chunk : chunks)
+                {
+                    if (!chunk.fromHistory)
+                    {
+                        continue;
+                    }
+                    for (uint32_t index : chunk.shards[shard])
+                    {
+                        chunk.keep[index] = true;
+                        if (!newRecords.empty())
+                        {
+                            const HistoryRecord &record = chunk.records[index];
+                            auto it = newRecords.find(FileIdKey{record.file_id, record.mtime});
+                            if (it != newRecords.end())
+                            {
+                                *(it->second) = false;
+                            }
+                        }
+                    }
+                }
+            }
+
+            std::vector<NinjaFileHistory> &histories = shardHistories[shard];
+            std::vector<NinjaFileSummary> &summaries = shardSummaries[shard];
+            for (auto &chunk : chunks)
             {
-                NinjaFile file{line};
-                FileKey key {
-                    file.file_name(),
-                    file.time().time_since_epoch().count()
-                };
-                if (!existingRecords.contains(key))
+                for (uint32_t index : chunk.shards[shard])
                 {
-                    existingRecords.insert(key);
-                    allFiles.push_back(file);
-                    recordAdded = true;
+                    const HistoryRecord &record = chunk.records[index];
+                    if (chunk.keep[index] && matched[record.file_id])
+                    {
+                        int32_t &slot = historyIndex[record.file_id];
+                        if (summary_)
+                        {
+                            if (slot == -1)
+                            {
+                                slot = (int32_t)summaries.size();
+                                summaries.push_back(NinjaFileSummary(std::string(fileNames.str(record.file_id))));
+                            }
+                            summaries[slot].add_duration(record.end_time_ms - record.start_time_ms);
+                            continue;
+                        }
+                        if (slot == -1)
+                        {
+                            slot = (int32_t)histories.size();
+                            histories.push_back(NinjaFileHistory(std::string(fileNames.str(record.file_id))));
+                        }
+                        histories[slot].add_entry(NinjaFileHistoryEntry(
+                            record.start_time_ms,
+                            record.end_time_ms,
+                            ninja_clock_t::time_point(ninja_clock_t::duration(record.mtime))));
+                    }
                 }
             }
+            for (auto &fileHistory : histories)
+            {
+                fileHistory.sort();
+            }
+        });
+
+#ifdef NINJA_TIMES_STATS
+    if (RunStats::instance().enabled())
+    {
+        for (const auto &chunk : chunks)
+        {
+            RunStats::instance().add_count("history.records_parsed", chunk.records.size());
+            RunStats::instance().add_count("history.records_kept", std::count(chunk.keep.begin(), chunk.keep.end(), true));
         }
     }
-    if (recordAdded)
+#endif
+
+    STATS_NEXT(timer, "history.write");
+    if (compact_)
     {
         std::string tmpFile = history + ".$$$";
 
         ofstream f(tmpFile);
         if (!f.is_open())
         {
-            throw std::invalid_argument(SS("Can't open file" << tmpFile));
-        }
-        f << "# ninja log v5" << endl;
-        for (auto& file : allFiles)
-        {
-            f << file << endl;
+            throw std::invalid_argument(SS("Can't open file " << tmpFile));
         }
+        f << "# ninja log v5" << '\n';
+        writeRecords(f, chunks, true, fileNames);
+        writeRecords(f, chunks, false, fileNames);
         f.close();
-
-        if (std::filesystem::exists(history))
+        if (!f)
         {
-            std::filesystem::remove(history);
+            throw std::invalid_argument(SS("Can't write file " << tmpFile));
         }
-        std::filesystem::rename(tmpFile,history);
 
+        // the old history is still mapped, but that's fine on a POSIX filesystem.
+        std::filesystem::rename(tmpFile,history);
     }
-
- 
-
-    std::unordered_map<std::string, NinjaFileHistory> fileMap;
-    for (auto&file: allFiles)
+    else
     {
-        const std::string&name = file.file_name();
-        if (matcher.Matches(name))
+        bool recordAdded = false;
+        for (const auto &chunk : chunks)
+        {
+            if (!chunk.fromHistory && std::find(chunk.keep.begin(), chunk.keep.end(), true) != chunk.keep.end())
+            {
+                recordAdded = true;
+                break;
+            }
+        }
+        if (recordAdded)
         {
-            if (!fileMap.contains(name))
+            ofstream f(history, std::ios_base::app);
+            if (!f.is_open())
+            {
+                throw std::invalid_argument(SS("Can't open file " << history));
+            }
+            if (!historyReader)
             {
-                fileMap[name] = NinjaFileHistory(file.file_name());
+                f << "# ninja log v5" << '\n';
+            }
+            writeRecords(f, chunks, false, fileNames);
+            f.close();
+            if (!f)
+            {
+                throw std::invalid_argument(SS("Can't write file " << history));
             }
-            fileMap[name].add_file(file);
         }
     }
 
-    for (auto &entry : fileMap)
+    // Written after the history, so that a failure in between just causes the records
+    // to be merged (and deduplicated) again on the next run.
+    HistoryCheckpoint newCheckpoint(logReader.file(), logEnd);
+    if (!(newCheckpoint == checkpoint) && std::filesystem::exists(history))
     {
-        entry.second.sort();
-        this->file_histories_.push_back(entry.second);
+        newCheckpoint.save(checkpointFile);
     }
 
-    struct
+    STATS_NEXT(timer, "history.index");
+    // Only the lines appended to the history are indexed, unless it has been rewritten.
+    if (std::filesystem::exists(history))
     {
-        bool operator()(const NinjaFileHistory &v1, const NinjaFileHistory &v2)
+        indexChanged |= fileIndex.update(NinjaLogReader(history), threads);
+        if (indexChanged)
         {
-            return v1.filename() < v2.filename();
+            fileIndex.save(indexFile);
         }
-    } Compare;
-    std::sort(this->file_histories_.begin(), this->file_histories_.end(), Compare);
+    }
+
+    STATS_NEXT(timer, "history.sort");
+    // Sort matching files by name once, then collect their histories in that order.
+    std::vector<uint32_t> matchedIds;
+    for (uint32_t fileId = 0; fileId < fileCount; ++fileId)
+    {
+        if (historyIndex[fileId] != -1)
+        {
+            matchedIds.push_back(fileId);
+        }
+    }
+    std::sort(matchedIds.begin(), matchedIds.end(),
+        [&](uint32_t a, uint32_t b)
+        {
+            return fileNames.str(a) < fileNames.str(b);
+        });
+    if (summary_)
+    {
+        file_summaries_.reserve(matchedIds.size());
+        for (uint32_t fileId : matchedIds)
+        {
+            file_summaries_.push_back(std::move(shardSummaries[fileId % shardCount][historyIndex[fileId]]));
+        }
+        return;
+    }
+    file_histories_.reserve(matchedIds.size());
+    for (uint32_t fileId : matchedIds)
+    {
+        file_histories_.push_back(std::move(shardHistories[fileId % shardCount][historyIndex[fileId]]));
+    }
 }
 
-void NinjaLog::load(const std::string& filename, const std::string&pattern)
+void NinjaHistory::load_binary(const std::string&filename, const GlobMatcher&matcher)
 {
-    GlobMatcher matcher(pattern);
-    fstream f(filename);
-    if (!f.is_open())
+    size_t threads = resolve_thread_count(threads_);
+
+    std::string textHistory = filename + ".history";
+    std::string history = textHistory + ".bin";
+    std::string checkpointFile = history + ".checkpoint";
+
+    STATS_TIMER(timer, "history.read");
+    NinjaLogReader logReader(filename);
+    logReader.check_header();
+
+    HistoryCheckpoint checkpoint;
+    bool haveCheckpoint = false;
+    bool converted = false;
+    if (!std::filesystem::exists(history))
     {
-        throw std::invalid_argument(SS("Can't open file" << filename));
+        // first use: convert the text history. Its checkpoint describes the converted records too.
+        if (std::filesystem::exists(textHistory))
+        {
+            NinjaLogReader textReader(textHistory);
+            std::vector<BinaryHistoryRecord> records;
+            textReader.for_each(
+                [&](const NinjaRecord &record)
+                {
+                    checkRecordTimes(textReader, record);
+                    records.push_back(BinaryHistoryRecord(record));
+                });
+            BinaryHistoryFile::write(history, records, pack_);
+            haveCheckpoint = checkpoint.load(textHistory + ".checkpoint");
+            converted = true;
+        }
+        else
+        {
+            BinaryHistoryFile::create(history, pack_);
+        }
     }
-    std::string line;
-    std::unordered_map<std::string, NinjaFile> fileMap;
-    while (std::getline(f, line))
+    else if (!compact_)
     {
-        if (line.starts_with('#'))
+        haveCheckpoint = checkpoint.load(checkpointFile);
+    }
+
+    std::unique_ptr<BinaryHistoryFile> store = std::make_unique<BinaryHistoryFile>(history);
+
+    size_t logStart = haveCheckpoint ? checkpoint.resume_offset(logReader.file()) : 0;
+    size_t logEnd = HistoryCheckpoint::complete_lines_end(logReader.text(), logStart);
+    std::vector<std::string_view> chunks = NinjaLogReader::chunks(logReader.text().substr(logStart, logEnd - logStart), threads);
+
+    STATS_COUNT("log.bytes", logEnd - logStart);
+    STATS_COUNT("history.bytes", store->valid_size());
+
+    STATS_NEXT(timer, "history.parse_log");
+    std::vector<std::vector<NinjaRecord>> chunkRecords(chunks.size());
+    parallel_for(chunks.size(), threads,
+        [&](size_t i)
         {
-            continue;
+            logReader.for_each(
+                chunks[i],
+                [&](const NinjaRecord &record)
+                {
+                    checkRecordTimes(logReader, record);
+                    chunkRecords[i].push_back(record);
+                });
+        });
+
+    STATS_NEXT(timer, "history.dedup");
+    if (compact_)
+    {
+        std::vector<BinaryHistoryRecord> records;
+        records.reserve(store->record_count());
+        std::unordered_set<FileIdKey> existingRecords{1000};
+        for (const auto &segment : store->segments())
+        {
+            for (size_t i = 0; i < segment.record_count; ++i)
+            {
+                if (existingRecords.insert(FileIdKey{segment.file_id[i], segment.mtime[i]}).second)
+                {
+                    records.push_back(store->record(segment, i));
+                }
+            }
+        }
+        const auto &nameIds = store->name_ids();
+        std::unordered_set<FileKey> newFileRecords;
+        for (const auto &chunk : chunkRecords)
+        {
+            for (const auto &record : chunk)
+            {
+                auto it = nameIds.find(record.file_name);
+                bool inserted = (it != nameIds.end())
+                                    ? existingRecords.insert(FileIdKey{it->second, record.mtime}).second
+                                    : newFileRecords.insert(FileKey{record.file_name, record.mtime}).second;
+                if (inserted)
+                {
+                    records.push_back(BinaryHistoryRecord(record));
+                }
+            }
+        }
+        if (retention_.is_set())
+        {
+            std::vector<uint8_t> keep(records.size(), true);
+            std::unordered_map<std::string_view, std::vector<HistoryRetention::Record>> fileRecords;
+            for (size_t i = 0; i < records.size(); ++i)
+            {
+                fileRecords[records[i].file_name].push_back(HistoryRetention::Record{records[i].mtime, &keep[i]});
+            }
+            uint64_t now = (uint64_t)ninja_clock_t::now().time_since_epoch().count();
+            for (auto &entry : fileRecords)
+            {
+                retention_.apply(entry.second, now);
+            }
+            size_t kept = 0;
+            for (size_t i = 0; i < records.size(); ++i)
+            {
+                if (keep[i])
+                {
+                    records[kept++] = records[i];
+                }
+            }
+            records.resize(kept);
+        }
+        STATS_COUNT("history.records_kept", records.size());
+        STATS_NEXT(timer, "history.write");
+        BinaryHistoryFile::write(history, records, pack_);
+    }
+    else
+    {
+        // Index the new records, then probe the (much larger) history for duplicates of them.
+        // Only files that appear in the new records need to be probed.
+        const auto &nameIds = store->name_ids();
+        std::vector<uint8_t> keep;
+        std::unordered_set<FileKey> newKeys;
+        std::unordered_map<FileIdKey, size_t> knownFileKeys;
+        std::vector<uint8_t> probeFile(store->name_count());
+        std::vector<const NinjaRecord *> newRecords;
+        for (const auto &chunk : chunkRecords)
+        {
+            for (const auto &record : chunk)
+            {
+                bool isNew = newKeys.insert(FileKey{record.file_name, record.mtime}).second;
+                if (isNew)
+                {
+                    auto it = nameIds.find(record.file_name);
+                    if (it != nameIds.end())
+                    {
+                        knownFileKeys[FileIdKey{it->second, record.mtime}] = newRecords.size();
+                        probeFile[it->second] = true;
+                    }
+                }
+                newRecords.push_back(&record);
+                keep.push_back(isNew);
+            }
         }
-        if (line.length() != 0)
+        if (knownFileKeys.size() != 0)
         {
-            NinjaFile file{line};
-            if (matcher.Matches(file.file_name()))
+            for (const auto &segment : store->segments())
             {
-                std::string name = file.file_name();
-                fileMap[name] = std::move(file);
+                for (size_t i = 0; i < segment.record_count; ++i)
+                {
+                    uint32_t fileId = segment.file_id[i];
+                    if (probeFile[fileId])
+                    {
+                        auto it = knownFileKeys.find(FileIdKey{fileId, segment.mtime[i]});
+                        if (it != knownFileKeys.end())
+                        {
+                            keep[it->second] = false;
+                        }
+                    }
+                }
             }
         }
+        std::vector<BinaryHistoryRecord> records;
+        for (size_t i = 0; i < newRecords.size(); ++i)
+        {
+            if (keep[i])
+            {
+                records.push_back(BinaryHistoryRecord(*newRecords[i]));
+            }
+        }
+        STATS_COUNT("history.records_added", records.size());
+        STATS_NEXT(timer, "history.write");
+        BinaryHistoryFile::append(history, *store, records);
     }
 
-    for (const auto &entry : fileMap)
+    // Written after the history, so that a failure in between just causes the records
+    // to be merged (and deduplicated) again on the next run.
+    HistoryCheckpoint newCheckpoint(logReader.file(), logEnd);
+    if (converted || !(newCheckpoint == checkpoint))
     {
-        this->files_.push_back(entry.second);
+        newCheckpoint.save(checkpointFile);
     }
 
-    struct
+    STATS_NEXT(timer, "history.match");
+    // Match each distinct file name once, then gather the records of matching files.
+    store = std::make_unique<BinaryHistoryFile>(history);
+    std::vector<uint8_t> matched = matchFileNames(matcher, store->name_count(), threads,
+        [&](uint32_t fileId)
+        {
+            return store->name(fileId);
+        });
+
+    std::vector<uint32_t> matchedIds;
+    for (uint32_t fileId = 0; fileId < matched.size(); ++fileId)
     {
-        bool operator()(const NinjaFile &v1, const NinjaFile &v2)
+        if (matched[fileId])
         {
-            return v1.duration_ms() > v2.duration_ms();
+            matchedIds.push_back(fileId);
         }
-    } Compare;
-    std::sort(this->files_.begin(), this->files_.end(), Compare);
+    }
+    std::sort(matchedIds.begin(), matchedIds.end(),
+        [&](uint32_t a, uint32_t b)
+        {
+            return store->name(a) < store->name(b);
+        });
+
+    STATS_NEXT(timer, "history.collect");
+    if (summary_)
+    {
+        summarize_binary(*store, matchedIds, threads);
+        return;
+    }
+
+    std::vector<int32_t> historyIndex(store->name_count(), -1);
+    for (uint32_t fileId : matchedIds)
+    {
+        historyIndex[fileId] = (int32_t)file_histories_.size();
+        file_histories_.push_back(NinjaFileHistory(std::string(store->name(fileId))));
+    }
+    if (file_histories_.size() != 0)
+    {
+        for (const auto &segment : store->segments())
+        {
+            for (size_t i = 0; i < segment.record_count; ++i)
+            {
+                int32_t index = historyIndex[segment.file_id[i]];
+                if (index >= 0)
+                {
+                    file_histories_[index].add_entry(NinjaFileHistoryEntry(
+                        segment.start_time_ms[i],
+                        segment.end_time_ms[i],
+                        ninja_clock_t::time_point(ninja_clock_t::duration(segment.mtime[i]))));
+                }
+            }
+        }
+    }
+    STATS_NEXT(timer, "history.sort");
+    parallel_for(file_histories_.size(), threads,
+        [&](size_t i)
+        {
+            file_histories_[i].sort();
+        });
+
 }
 
-const std::vector<NinjaFile> &NinjaLog::files() const
+void NinjaHistory::summarize_binary(const BinaryHistoryFile &store, const std::vector<uint32_t> &matchedIds, size_t threads)
 {
-    return files_;
+    std::vector<int32_t> summaryIndex(store.name_count(), -1);
+    for (uint32_t fileId : matchedIds)
+    {
+        summaryIndex[fileId] = (int32_t)file_summaries_.size();
+        file_summaries_.push_back(NinjaFileSummary(std::string(store.name(fileId))));
+    }
+    if (file_summaries_.empty())
+    {
+        return;
+    }
+
+    // Each thread summarizes an equal range of records, then the threads' summaries of each file are merged.
+    size_t rangeCount = std::min(threads, std::max<size_t>(1, store.record_count() / (64 * 1024)));
+    std::vector<std::vector<NinjaFileSummary>> rangeSummaries(rangeCount);
+    std::vector<std::vector<int32_t>> rangeIndexes(rangeCount);
+    parallel_for(rangeCount, threads,
+        [&](size_t range)
+        {
+            size_t begin = store.record_count() * range / rangeCount;
+            size_t end = store.record_count() * (range + 1) / rangeCount;
+            std::vector<NinjaFileSummary> &summaries = rangeSummaries[range];
+            std::vector<int32_t> &localIndex = rangeIndexes[range];
+            localIndex.resize(file_summaries_.size(), -1);
+
+            size_t segmentStart = 0;
+            for (const auto &segment : store.segments())
+            {
+                size_t first = std::max(begin, segmentStart);
+                size_t last = std::min(end, segmentStart + segment.record_count);
+                for (size_t i = first; i < last; ++i)
+                {
+                    size_t j = i - segmentStart;
+                    int32_t index = summaryIndex[segment.file_id[j]];
+                    if (index < 0)
+                    {
+                        continue;
+                    }
+                    int32_t &slot = localIndex[index];
+                    if (slot == -1)
+                    {
+                        slot = (int32_t)summaries.size();
+                        summaries.push_back(NinjaFileSummary());
+                    }
+                    summaries[slot].add_duration(segment.end_time_ms[j] - segment.start_time_ms[j]);
+                }
+                segmentStart += segment.record_count;
+            }
+        });
+    parallel_for(file_summaries_.size(), threads,
+        [&](size_t i)
+        {
+            for (size_t range = 0; range < rangeCount; ++range)
+            {
+                int32_t slot = rangeIndexes[range][i];
+                if (slot != -1)
+                {
+                    file_summaries_[i].merge(rangeSummaries[range][slot]);
+                }
+            }
+        });
 }
 
-static std::vector<std::string> split(const std::string &line, char separator)
+size_t NinjaHistory::record_count() const
 {
-    std::vector<std::string> result;
-    std::stringstream s(line);
-    std::string t;
-    while(getline(s,t,separator)) {
-        result.push_back(t);
+    size_t result = 0;
+    for (const auto &fileHistory : file_histories_)
+    {
+        result += fileHistory.entries().size();
+    }
+    for (const auto &fileSummary : file_summaries_)
+    {
+        result += fileSummary.count();
     }
     return result;
 }
-template<typename T> 
-void convert(const std::string&str,T*result)
+
+void NinjaLog::load(const std::string& filename, const GlobMatcher&matcher)
 {
-    std::stringstream s(str);
-    s >> *result;
-    if (s.fail())
+    size_t threads = resolve_thread_count(threads_);
+    STATS_TIMER(timer, "log.read");
+    NinjaLogReader reader(filename);
+    std::vector<std::string_view> chunks = reader.chunks(threads);
+    STATS_COUNT("log.bytes", reader.text().length());
+
+    STATS_NEXT(timer, "log.parse");
+    // Lines that can't match are skipped without being parsed. Later records replace earlier
+    // ones. Only records that survive are copied into NinjaFiles.
+    LiteralPrefilter prefilter(matcher.RequiredLiterals());
+    StringInterner fileNames;
+    std::vector<std::unordered_map<uint32_t, NinjaRecord>> chunkMaps(chunks.size());
+    parallel_for(chunks.size(), threads,
+        [&](size_t i)
+        {
+            auto &fileMap = chunkMaps[i];
+            reader.for_each(
+                chunks[i],
+                prefilter,
+                [&](const NinjaRecord &record)
+                {
+                    fileMap[fileNames.intern(record.file_name)] = record;
+                });
+        });
+
+    // merge in file order, to preserve "last record wins".
+    std::unordered_map<uint32_t, NinjaRecord> fileMap;
+    if (chunkMaps.size() != 0)
     {
-        throw std::logic_error("Invalid file format.");
+        fileMap = std::move(chunkMaps[0]);
+        for (size_t i = 1; i < chunkMaps.size(); ++i)
+        {
+            for (const auto &entry : chunkMaps[i])
+            {
+                fileMap.insert_or_assign(entry.first, entry.second);
+            }
+        }
+    }
+
+    STATS_COUNT("log.files", fileMap.size());
+
+    STATS_NEXT(timer, "log.match");
+    std::vector<uint8_t> matched = matchFileNames(matcher, fileNames.max_id(), threads,
+        [&](uint32_t fileId)
+        {
+            return fileNames.is_valid(fileId) ? fileNames.str(fileId) : std::string_view();
+        });
+
+    STATS_NEXT(timer, "log.sort");
+    // Select on the parsed records, so that NinjaFiles (and their string copies) are only
+    // created for the files that are kept.
+    std::vector<const NinjaRecord *> selected;
+    selected.reserve(fileMap.size());
+    for (const auto &entry : fileMap)
+    {
+        if (matched[entry.first])
+        {
+            selected.push_back(&entry.second);
+        }
     }
+    auto slowerThan = [](const NinjaRecord *v1, const NinjaRecord *v2)
+    {
+        return v1->duration_ms() > v2->duration_ms();
+    };
+    if (top_ != 0 && top_ < selected.size())
+    {
+        std::nth_element(selected.begin(), selected.begin() + top_, selected.end(), slowerThan);
+        selected.resize(top_);
+    }
+    std::sort(selected.begin(), selected.end(), slowerThan);
+
+    this->files_.reserve(selected.size());
+    for (const NinjaRecord *record : selected)
+    {
+        this->files_.push_back(NinjaFile(*record));
+    }
+}
 
+const std::vector<NinjaFile> &NinjaLog::files() const
+{
+    return files_;
 }
+
 NinjaFile::NinjaFile(const std::string &line)
+    : NinjaFile()
 {
-    uint64_t iFileTime;
-    std::string discard;
-    std::vector<std::string> fields = split(line,'\t');
-    if (fields.size() < 5) {
+    NinjaRecord record;
+    if (!parse_ninja_record(line, &record))
+    {
         throw std::logic_error("Invalid file format.");
     }
-    convert(fields[0],&start_time_);
-    convert(fields[1],&end_time_);
-    convert(fields[2],&iFileTime);
-    filename_ = fields[3];
-    extra_ = fields[4];
+    *this = NinjaFile(record);
+}
 
-    ninja_clock_t::duration durationSinceEpoch(iFileTime);
-    ninja_clock_t::time_point fileTime{durationSinceEpoch};
-    this->time_ = fileTime;
+NinjaFile::NinjaFile(const NinjaRecord &record)
+    : start_time_(record.start_time_ms),
+      end_time_(record.end_time_ms),
+      time_(ninja_clock_t::duration(record.mtime)),
+      filename_(record.file_name),
+      extra_(record.extra)
+{
 }
 
 uint64_t NinjaFile::start_time_ms() const { return start_time_; }
@@ -278,6 +1099,13 @@ const ninja_clock_t::time_point &NinjaFile::time() const
     return time_;
 }
 
+NinjaFileSummary::NinjaFileSummary()
+{
+}
+NinjaFileSummary::NinjaFileSummary(const std::string &fileName__) : filename_(fileName__)
+{
+}
+
 NinjaFileHistory::NinjaFileHistory()
 {
 
@@ -300,6 +1128,10 @@ void NinjaFileHistory::add_file(const NinjaFile &file)
 {
     this->entries_.push_back(NinjaFileHistoryEntry(file));
 }
+void NinjaFileHistory::add_file(const NinjaRecord &record)
+{
+    this->entries_.push_back(NinjaFileHistoryEntry(record));
+}
 void NinjaFileHistory::sort()
 {
     struct
@@ -320,38 +1152,151 @@ NinjaFileHistoryEntry::NinjaFileHistoryEntry(const NinjaFile &file)
 
 {
 }
+NinjaFileHistoryEntry::NinjaFileHistoryEntry(const NinjaRecord &record)
+    : startTime_(record.start_time_ms),
+      endTime_(record.end_time_ms),
+      time_(ninja_clock_t::duration(record.mtime))
+{
+}
+NinjaFileHistoryEntry::NinjaFileHistoryEntry(uint64_t startTime, uint64_t endTime, const ninja_clock_t::time_point &time)
+    : startTime_(startTime),
+      endTime_(endTime),
+      time_(time)
+{
+}
 NinjaFileHistoryEntry::NinjaFileHistoryEntry()
    : startTime_(0),
       endTime_(0)
 {
 }
 
-std::string timeToString(const ninja_clock_t::time_point &time)
+void NinjaBuilds::load(const std::string&filename)
+{
+    // merge without loading any file histories.
+    NinjaHistory history;
+    history.set_threads(threads_);
+    history.set_format(format_);
+    history.load(filename, GlobMatcher({}, {"*"}));
+
+    historyFormat_ = resolveFormat(filename, format_);
+    historyFile_ = filename + (historyFormat_ == HistoryFormat::Binary ? ".history.bin" : ".history");
+    std::string indexFile = historyFile_ + ".builds";
+
+    BuildIndex index;
+    index.load(indexFile);
+    bool changed = false;
+    if (historyFormat_ == HistoryFormat::Binary)
+    {
+        changed = index.update(BinaryHistoryFile(historyFile_));
+    }
+    else if (std::filesystem::exists(historyFile_))
+    {
+        changed = index.update(NinjaLogReader(historyFile_), threads_);
+    }
+    if (changed)
+    {
+        index.save(indexFile);
+    }
+    builds_ = index.builds();
+}
+
+std::vector<NinjaFile> NinjaBuilds::build_files(size_t buildId, size_t top) const
 {
-    std::stringstream ss;
-    auto in_time_t = ninja_clock_t::to_time_t(time);
-                ss << std::put_time(std::localtime(&in_time_t), "%Y-%m-%d %X");
-    return ss.str();
-    
+    if (buildId < 1 || buildId > builds_.size())
+    {
+        throw std::invalid_argument(SS("Build " << buildId << " not found. The history has " << builds_.size() << " builds."));
+    }
+    const BuildSession &build = builds_[buildId - 1];
+
+    std::vector<NinjaRecord> records;
+    records.reserve(build.record_count);
+    std::unique_ptr<NinjaLogReader> textHistory;
+    std::unique_ptr<BinaryHistoryFile> binaryHistory;
+    if (historyFormat_ == HistoryFormat::Binary)
+    {
+        binaryHistory = std::make_unique<BinaryHistoryFile>(historyFile_);
+        for (const BinaryHistoryRecord &record : binaryHistory->records(build.begin, build.end))
+        {
+            NinjaRecord ninjaRecord;
+            ninjaRecord.start_time_ms = record.start_time_ms;
+            ninjaRecord.end_time_ms = record.end_time_ms;
+            ninjaRecord.mtime = record.mtime;
+            ninjaRecord.file_name = record.file_name;
+            records.push_back(ninjaRecord);
+        }
+    }
+    else
+    {
+        textHistory = std::make_unique<NinjaLogReader>(historyFile_);
+        if (build.end > textHistory->text().length())
+        {
+            throw std::invalid_argument(SS("The build index of " << historyFile_ << " is out of date."));
+        }
+        textHistory->for_each(
+            textHistory->text().substr(build.begin, build.end - build.begin),
+            [&](const NinjaRecord &record)
+            {
+                records.push_back(record);
+            });
+    }
+
+    auto slowerThan = [](const NinjaRecord &v1, const NinjaRecord &v2)
+    {
+        return v1.duration_ms() > v2.duration_ms();
+    };
+    if (top != 0 && top < records.size())
+    {
+        std::nth_element(records.begin(), records.begin() + top, records.end(), slowerThan);
+        records.resize(top);
+    }
+    std::sort(records.begin(), records.end(), slowerThan);
+
+    std::vector<NinjaFile> result;
+    result.reserve(records.size());
+    for (const NinjaRecord &record : records)
+    {
+        result.push_back(NinjaFile(record));
+    }
+    return result;
 }
+
 std::ostream&operator<<(std::ostream&os,const NinjaHistory &history)
 {
+    OutputWriter out(os);
+    if (history.is_summary())
+    {
+        out.write_right("count", 8);
+        for (const char *column : {"min", "p50", "p90", "p99", "max"})
+        {
+            out.write_right(column, 10);
+        }
+        out.write("  file\n");
+        for (const auto &summary : history.file_summaries())
+        {
+            out.write_uint(summary.count(), 8);
+            out.write_fixed(summary.min_ms() / 1000.0, 3, 10);
+            out.write_fixed(summary.quantile_ms(0.5) / 1000.0, 3, 10);
+            out.write_fixed(summary.quantile_ms(0.9) / 1000.0, 3, 10);
+            out.write_fixed(summary.quantile_ms(0.99) / 1000.0, 3, 10);
+            out.write_fixed(summary.max_ms() / 1000.0, 3, 10);
+            out.write("  ");
+            out.write(summary.filename());
+            out.put('\n');
+        }
+        return os;
+    }
     for (const auto& history: history.file_histories())
     {
-        os << history.filename() << endl;
+        out.write(history.filename());
+        out.put('\n');
         for (const auto &entry: history.entries())
         {
-
-
-            os << setw(22) << timeToString(entry.time())
-            << setw(8) 
-            << setprecision(3) << fixed << (entry.duration_ms() / 1000.00) 
-            << endl;
-            ;
- 
+            out.write_time(entry.time(), 22);
+            out.write_fixed(entry.duration_ms() / 1000.00, 3, 8);
+            out.put('\n');
         }
-        os << endl;
-}
+        out.put('\n');
+    }
     return os;
 }
 
@@ -364,3 +1309,30 @@ std::ostream&operator<<(std::ostream&s, const NinjaFile&ninjaFile)
     << '\t' << ninjaFile.extra();
     return s;
 }
+
+std::ostream&operator<<(std::ostream&s,const NinjaBuilds &builds)
+{
+    OutputWriter out(s);
+    out.write_right("build", 6);
+    out.write_right("finished", 22);
+    out.write_right("edges", 8);
+    out.write_right("wall", 12);
+    out.write_right("cpu", 12);
+    out.write_right("slowest", 10);
+    out.write("  file\n");
+    size_t buildId = 0;
+    for (const BuildSession &build : builds.builds())
+    {
+        ++buildId;
+        out.write_uint(buildId, 6);
+        out.write_time(ninja_clock_t::time_point(ninja_clock_t::duration(build.mtime)), 22);
+        out.write_uint(build.record_count, 8);
+        out.write_fixed(build.wall_time_ms() / 1000.0, 3, 12);
+        out.write_fixed(build.cpu_time_ms / 1000.0, 3, 12);
+        out.write_fixed(build.slowest_ms / 1000.0, 3, 10);
+        out.write("  ");
+        out.write(build.slowest_file);
+        out.put('\n');
+    }
+    return s;
+}
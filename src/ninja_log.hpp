@@ -27,6 +27,11 @@
 #include <string>
 #include <chrono>
 #include <iostream>
+#include "ninja_log_reader.hpp"
+#include "GlobMatcher.hpp"
+#include "build_index.hpp"
+#include "t_digest.hpp"
+#include "history_retention.hpp"
 
 using ninja_clock_t = std::chrono::system_clock;
 
@@ -35,6 +40,7 @@ class NinjaFile {
 public:
     NinjaFile();
     NinjaFile(const std::string &line);
+    NinjaFile(const NinjaRecord &record);
 
     uint64_t start_time_ms() const;
     uint64_t end_time_ms() const;
@@ -59,18 +65,29 @@ std::ostream&operator<<(std::ostream&s, const NinjaFile&ninjaFile);
 
 class NinjaLog {
 public:
-    void load(const std::string&filename,const std::string&pattern);
+    // Number of threads used to load the log. 0 (the default) uses one thread per core.
+    void set_threads(size_t threads) { threads_ = threads; }
 
+    // Keep only the top slowest files. 0 (the default) keeps all files.
+    void set_top(size_t top) { top_ = top; }
+
+    void load(const std::string&filename,const GlobMatcher&matcher);
+
+    // Slowest first.
     const std::vector<NinjaFile> &files() const;
 
 private:
+    size_t threads_ = 0;
+    size_t top_ = 0;
     std::vector<NinjaFile> files_;
 };
 
 class NinjaFileHistoryEntry {
 public:
     NinjaFileHistoryEntry();
+    NinjaFileHistoryEntry(uint64_t startTime, uint64_t endTime, const ninja_clock_t::time_point &time);
     NinjaFileHistoryEntry(const NinjaFile&file);
+    NinjaFileHistoryEntry(const NinjaRecord&record);
 
     uint64_t start_time_ms() const { return startTime_; }
     uint64_t end_time_ms() const { return endTime_; }
@@ -88,24 +105,113 @@ public:
     NinjaFileHistory(const std::string& fileName);
     const std::string&filename() const { return filename_; }
 
-    std::vector<NinjaFileHistoryEntry> entries() const  { return entries_; }
+    const std::vector<NinjaFileHistoryEntry> &entries() const  { return entries_; }
 
 
     void add_file(const NinjaFile&file);
+    void add_file(const NinjaRecord&record);
+    void add_entry(const NinjaFileHistoryEntry&entry) { entries_.push_back(entry); }
     void sort();
 private:
     std::string filename_;
     std::vector<NinjaFileHistoryEntry> entries_;
 };
 
+// Distribution of a file's build times, in ms, summarized in bounded memory.
+class NinjaFileSummary {
+public:
+    NinjaFileSummary();
+    NinjaFileSummary(const std::string& fileName);
+    const std::string&filename() const { return filename_; }
+
+    void add_duration(uint64_t durationMs) { durations_.add((double)durationMs); }
+    void merge(const NinjaFileSummary&other) { durations_.merge(other.durations_); }
+
+    size_t count() const { return (size_t)durations_.count(); }
+    double min_ms() const { return durations_.min(); }
+    double max_ms() const { return durations_.max(); }
+    double quantile_ms(double q) const { return durations_.quantile(q); }
+private:
+    std::string filename_;
+    TDigest durations_;
+};
+
+enum class HistoryFormat {
+    Auto,   // binary if a .ninja_log.history.bin file exists; otherwise text.
+    Text,   // .ninja_log.history
+    Binary  // .ninja_log.history.bin
+};
 
 class NinjaHistory {
 public:
-    void load(const std::string&filename,const std::string&pattern);
+    // Number of threads used to load the history. 0 (the default) uses one thread per core.
+    void set_threads(size_t threads) { threads_ = threads; }
+
+    // Rewrite the whole history, removing duplicate records, instead of appending new records to it.
+    void set_compact(bool compact) { compact_ = compact; }
+
+    // Records that are not retained are dropped when the history is compacted.
+    void set_retention(const HistoryRetention &retention) { retention_ = retention; }
+
+    // Pack the binary history when it is created or compacted. Packing roughly halves its size, but
+    // packed records must be decoded before they can be queried.
+    void set_pack(bool pack) { pack_ = pack; }
+
+    // The format of the history file. If a binary history doesn't exist yet, it is created
+    // from the text history.
+    void set_format(HistoryFormat format) { format_ = format; }
+
+    // Load a summary of each file's build times (file_summaries()) instead of every entry.
+    void set_summary(bool summary) { summary_ = summary; }
+
+    // Merges records that ninja has added to the log since the last run into the log's
+    // .history journal, and loads the history of files that match matcher.
+    void load(const std::string&filename,const GlobMatcher&matcher);
     const std::vector<NinjaFileHistory> &file_histories() const ;
+    const std::vector<NinjaFileSummary> &file_summaries() const { return file_summaries_; }
+    bool is_summary() const { return summary_; }
+    size_t record_count() const;
 private:
+    void load_text(const std::string&filename,const GlobMatcher&matcher);
+    void load_binary(const std::string&filename,const GlobMatcher&matcher);
+    void summarize_binary(const BinaryHistoryFile&store,const std::vector<uint32_t>&matchedIds,size_t threads);
+
+    size_t threads_ = 0;
+    bool compact_ = false;
+    bool pack_ = false;
+    HistoryRetention retention_;
+    HistoryFormat format_ = HistoryFormat::Auto;
+    bool summary_ = false;
     std::vector<NinjaFileHistory> file_histories_;
+    std::vector<NinjaFileSummary> file_summaries_;
 };
 
 
-std::ostream&operator<<(std::ostream&s,const NinjaHistory &history);
\ No newline at end of file
+std::ostream&operator<<(std::ostream&s,const NinjaHistory &history);
+
+class NinjaBuilds {
+public:
+    // Number of threads used to load the history. 0 (the default) uses one thread per core.
+    void set_threads(size_t threads) { threads_ = threads; }
+
+    void set_format(HistoryFormat format) { format_ = format; }
+
+    // Merges new log records into the history, and updates the history's index of builds.
+    void load(const std::string&filename);
+
+    // Oldest first. Build IDs are 1-based indexes into this list.
+    const std::vector<BuildSession> &builds() const { return builds_; }
+
+    // The top slowest files of a build, slowest first. 0 returns all of its files. Reads only
+    // the build's records.
+    std::vector<NinjaFile> build_files(size_t buildId, size_t top) const;
+
+private:
+    size_t threads_ = 0;
+    HistoryFormat format_ = HistoryFormat::Auto;
+    std::string historyFile_;
+    HistoryFormat historyFormat_ = HistoryFormat::Text;
+    std::vector<BuildSession> builds_;
+};
+
+std::ostream&operator<<(std::ostream&s,const NinjaBuilds &builds);
\ No newline at end of file
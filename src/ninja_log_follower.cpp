@@ -0,0 +1,256 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "ninja_log_follower.hpp"
+#include "output_writer.hpp"
+#include "ss.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+NinjaLogFollower::NinjaLogFollower(const std::string &filename, const GlobMatcher &matcher)
+    : filename_(filename),
+      matcher_(matcher)
+{
+    reset();
+}
+
+void NinjaLogFollower::reset()
+{
+    checkpoint_ = HistoryCheckpoint();
+    recordCount_ = 0;
+    fileNames_ = std::make_unique<StringInterner>();
+    matched_.clear();
+    durations_.clear();
+    ranking_.clear();
+}
+
+bool NinjaLogFollower::update()
+{
+    // Only a stat of the path, unless the log has been replaced (ninja recompacts it by writing a new
+    // file) or has outgrown the mapping.
+    struct stat st;
+    if (stat(filename_.c_str(), &st) == -1)
+    {
+        return false; // e.g. between ninja deleting and recreating the log.
+    }
+    bool replaced = !reader_ || (uint64_t)st.st_dev != reader_->file().device() || (uint64_t)st.st_ino != reader_->file().inode();
+    if (replaced || !reader_->refresh())
+    {
+        try
+        {
+            reader_ = std::make_unique<NinjaLogReader>(filename_, std::max((size_t)st.st_size * 2, MIN_MAPPING_SIZE));
+        }
+        catch (const std::invalid_argument &)
+        {
+            reader_.reset();
+            return false;
+        }
+    }
+
+    bool changed = false;
+    size_t start = checkpoint_.resume_offset(reader_->file());
+    if (start == 0 && recordCount_ != 0)
+    {
+        reset();
+        changed = true;
+    }
+    size_t end = HistoryCheckpoint::complete_lines_end(reader_->text(), start);
+    if (end == start)
+    {
+        return changed;
+    }
+    if (start == 0)
+    {
+        reader_->check_header();
+    }
+    reader_->for_each(
+        reader_->text().substr(start, end - start),
+        [&](const NinjaRecord &record)
+        {
+            add_record(record.file_name, record.duration_ms());
+        });
+    checkpoint_ = HistoryCheckpoint(reader_->file(), end);
+    return true;
+}
+
+void NinjaLogFollower::add_record(std::string_view fileName, uint64_t durationMs)
+{
+    ++recordCount_;
+    uint32_t fileId = fileNames_->intern(fileName);
+    if (fileId >= matched_.size())
+    {
+        matched_.resize(fileNames_->max_id(), UNKNOWN);
+        durations_.resize(fileNames_->max_id(), NO_DURATION);
+    }
+    if (matched_[fileId] == UNKNOWN)
+    {
+        matched_[fileId] = matcher_.Matches(fileNames_->str(fileId)) ? MATCHED : UNMATCHED;
+    }
+    if (matched_[fileId] != MATCHED)
+    {
+        return;
+    }
+    // the latest record for a file replaces earlier ones.
+    uint64_t &duration = durations_[fileId];
+    if (duration != NO_DURATION)
+    {
+        ranking_.erase({duration, fileId});
+    }
+    duration = durationMs;
+    ranking_.insert({duration, fileId});
+}
+
+std::vector<NinjaLogFollower::FileTime> NinjaLogFollower::top_files() const
+{
+    std::vector<FileTime> result;
+    for (const auto &entry : ranking_)
+    {
+        if (result.size() == top_)
+        {
+            break;
+        }
+        result.push_back(FileTime{fileNames_->str(entry.second), entry.first});
+    }
+    return result;
+}
+
+void NinjaLogFollower::write_table(std::ostream &out, bool redraw) const
+{
+    StreamFormatGuard formatGuard(out);
+    if (redraw)
+    {
+        out << "\x1b[H\x1b[2J"; // home, and clear the screen.
+    }
+    out << "Following " << filename_ << ": " << file_count() << " files, " << record_count() << " records." << '\n';
+    for (const auto &file : top_files())
+    {
+        out << std::setw(8) << std::setprecision(3) << std::fixed << (file.duration_ms / 1000.00) << " " << file.file_name << '\n';
+    }
+    out << '\n';
+    out.flush();
+}
+
+#ifdef __linux__
+
+// Reads all pending events. Returns true if any of them may concern the file named name.
+static bool drainEvents(int fd, const std::string &name)
+{
+    bool relevant = false;
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    while (true)
+    {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0)
+        {
+            break; // EAGAIN: no more events.
+        }
+        for (char *p = buffer; p < buffer + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            if ((event->mask & IN_Q_OVERFLOW) || (event->len != 0 && name == event->name))
+            {
+                relevant = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return relevant;
+}
+
+void NinjaLogFollower::run(std::ostream &out, bool redraw)
+{
+    using namespace std::chrono_literals;
+    constexpr auto REFRESH_INTERVAL = 500ms;
+    constexpr int IDLE_CHECK_MS = 10000; // in case an event is missed.
+
+    // The directory is watched, rather than the file, since ninja replaces the log when it recompacts it.
+    std::filesystem::path path(filename_);
+    std::string directory = path.has_parent_path() ? path.parent_path().string() : std::string(".");
+    std::string name = path.filename().string();
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1 || inotify_add_watch(fd, directory.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_DELETE) == -1)
+    {
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        throw std::invalid_argument(SS("Can't watch directory " << directory));
+    }
+    try
+    {
+        update();
+        write_table(out, redraw);
+        while (true)
+        {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            int result = poll(&pfd, 1, IDLE_CHECK_MS);
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::logic_error(SS("Can't watch file " << filename_ << ": " << strerror(errno)));
+            }
+            if (result > 0)
+            {
+                // let a burst of appends accumulate.
+                std::this_thread::sleep_for(REFRESH_INTERVAL);
+                if (!drainEvents(fd, name))
+                {
+                    continue;
+                }
+            }
+            if (update())
+            {
+                write_table(out, redraw);
+            }
+        }
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+}
+
+#else
+
+void NinjaLogFollower::run(std::ostream &out, bool redraw)
+{
+    throw std::logic_error("--follow is only supported on Linux.");
+}
+
+#endif
@@ -0,0 +1,92 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "GlobMatcher.hpp"
+#include "history_checkpoint.hpp"
+#include "ninja_log_reader.hpp"
+#include "string_interner.hpp"
+
+// Follows a .ninja_log while a build is running, keeping a table of the slowest files up to date.
+//
+// The log stays open and mapped between updates, and each update parses only the records that ninja
+// has appended since the previous one. The log is mapped again only if it outgrows the mapping, or if
+// ninja replaces it. If ninja rewrites or recompacts the log (detected the same way as for history
+// checkpoints), the table is rebuilt from the new log.
+class NinjaLogFollower {
+public:
+    NinjaLogFollower(const std::string &filename, const GlobMatcher &matcher);
+
+    // Number of files in the table.
+    void set_top(size_t top) { top_ = top; }
+
+    // Merges records appended to the log since the last update. Returns true if the table may
+    // have changed.
+    bool update();
+
+    struct FileTime {
+        std::string_view file_name;
+        uint64_t duration_ms;
+    };
+    // The slowest matching files, slowest first.
+    std::vector<FileTime> top_files() const;
+
+    size_t file_count() const { return ranking_.size(); }
+    size_t record_count() const { return recordCount_; }
+
+    // Writes the table to out, then updates it and writes it again each time the log changes,
+    // until the process is interrupted. If redraw is set, the terminal is cleared before each table.
+    //
+    // Waits for changes with inotify, and coalesces bursts of appends, so that following a busy
+    // build costs at most a few updates per second.
+    void run(std::ostream &out, bool redraw);
+
+private:
+    static constexpr uint64_t NO_DURATION = UINT64_MAX;
+    // The log is mapped with room to grow to twice its size, and at least this much.
+    static constexpr size_t MIN_MAPPING_SIZE = 64 * 1024 * 1024;
+    enum MatchState : uint8_t { UNKNOWN, MATCHED, UNMATCHED };
+
+    void reset();
+    void add_record(std::string_view fileName, uint64_t durationMs);
+    void write_table(std::ostream &out, bool redraw) const;
+
+    std::string filename_;
+    GlobMatcher matcher_;
+    size_t top_ = 20;
+
+    std::unique_ptr<NinjaLogReader> reader_;
+    HistoryCheckpoint checkpoint_;
+    size_t recordCount_ = 0;
+    std::unique_ptr<StringInterner> fileNames_;
+    std::vector<uint8_t> matched_;       // MatchState, by file ID.
+    std::vector<uint64_t> durations_;    // latest duration, by file ID.
+    std::set<std::pair<uint64_t, uint32_t>, std::greater<>> ranking_; // (duration, file ID), slowest first.
+};
@@ -0,0 +1,262 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "ninja_log_reader.hpp"
+#include <stdexcept>
+#include <charconv>
+#include <algorithm>
+#include "ss.hpp"
+
+// Parses a numeric field and its trailing tab, returning a pointer to the next field or nullptr.
+static inline const char *parseNumber(const char *p, const char *end, uint64_t *value)
+{
+    auto result = std::from_chars(p, end, *value);
+    if (result.ec != std::errc() || result.ptr == end || *result.ptr != '\t')
+    {
+        return nullptr;
+    }
+    return result.ptr + 1;
+}
+
+const char *parse_ninja_record(const char *p, const char *end, NinjaRecord *record)
+{
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    const char *next;
+    if (eol == nullptr)
+    {
+        eol = end;
+        next = end;
+    }
+    else
+    {
+        next = eol + 1;
+    }
+    if ((p = parseNumber(p, eol, &record->start_time_ms)) == nullptr ||
+        (p = parseNumber(p, eol, &record->end_time_ms)) == nullptr ||
+        (p = parseNumber(p, eol, &record->mtime)) == nullptr)
+    {
+        return nullptr;
+    }
+    const char *tab = (const char *)memchr(p, '\t', eol - p);
+    if (tab == nullptr)
+    {
+        return nullptr;
+    }
+    record->file_name = std::string_view(p, tab - p);
+    ++tab;
+    record->extra = std::string_view(tab, eol - tab);
+    return next;
+}
+
+bool parse_ninja_record(std::string_view line, NinjaRecord *record)
+{
+    return parse_ninja_record(line.data(), line.data() + line.length(), record) != nullptr;
+}
+
+// Parses a numeric field that must occupy all of [p,end).
+static inline bool parseField(const char *p, const char *end, uint64_t *value)
+{
+    auto result = std::from_chars(p, end, *value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+NinjaBlockParser::NinjaBlockParser()
+{
+}
+
+NinjaBlockParser::NinjaBlockParser(DelimiterScanner::Isa isa)
+    : scanner_(isa)
+{
+}
+
+const char *NinjaBlockParser::parse(const char *p, const char *end)
+{
+    records_.resize(0);
+    errorLine_ = nullptr;
+
+    // Find a block that contains at least one complete line.
+    size_t length = std::min(BLOCK_SIZE, (size_t)(end - p));
+    size_t count;
+    const char *limit;
+    while (true)
+    {
+        if (positions_.size() < length)
+        {
+            positions_.resize(length);
+        }
+        count = scanner_.scan(p, length, positions_.data());
+        if (p + length == end)
+        {
+            limit = end;
+            break;
+        }
+        size_t lastNewline = count;
+        while (lastNewline != 0 && p[positions_[lastNewline - 1]] != '\n')
+        {
+            --lastNewline;
+        }
+        if (lastNewline != 0)
+        {
+            limit = p + positions_[lastNewline - 1] + 1;
+            count = lastNewline;
+            break;
+        }
+        length = std::min(length * 2, (size_t)(end - p)); // a very long line.
+    }
+
+    const uint32_t *position = positions_.data();
+    const uint32_t *positionEnd = position + count;
+    const char *line = p;
+    while (line < limit)
+    {
+        if (*line == '\n')
+        {
+            ++position;
+            ++line;
+            continue;
+        }
+        if (*line == '#')
+        {
+            while (position != positionEnd && p[*position] != '\n')
+            {
+                ++position;
+            }
+            if (position == positionEnd)
+            {
+                return limit;
+            }
+            line = p + *position + 1;
+            ++position;
+            continue;
+        }
+
+        const char *tabs[4];
+        for (size_t i = 0; i < 4; ++i)
+        {
+            if (position == positionEnd || p[*position] != '\t')
+            {
+                errorLine_ = line;
+                return nullptr;
+            }
+            tabs[i] = p + *position++;
+        }
+        // the extra field runs to the end of the line.
+        while (position != positionEnd && p[*position] != '\n')
+        {
+            ++position;
+        }
+        const char *eol = (position == positionEnd) ? limit : p + *position++;
+
+        NinjaRecord &record = records_.emplace_back();
+        if (!parseField(line, tabs[0], &record.start_time_ms) ||
+            !parseField(tabs[0] + 1, tabs[1], &record.end_time_ms) ||
+            !parseField(tabs[1] + 1, tabs[2], &record.mtime))
+        {
+            records_.pop_back();
+            errorLine_ = line;
+            return nullptr;
+        }
+        record.file_name = std::string_view(tabs[2] + 1, tabs[3] - tabs[2] - 1);
+        record.extra = std::string_view(tabs[3] + 1, eol - tabs[3] - 1);
+        line = eol + 1;
+    }
+    return limit;
+}
+
+void throw_ninja_format_error(const std::string &filename, const char *fileStart, const char *line)
+{
+    // Only counted when something has gone wrong, so the parsers don't have to track line numbers.
+    size_t lineNumber = 1 + std::count(fileStart, line, '\n');
+    if (filename.empty())
+    {
+        throw std::logic_error(SS("Invalid file format at line " << lineNumber << "."));
+    }
+    throw std::logic_error(SS("Invalid file format. " << filename << "(" << lineNumber << ")"));
+}
+
+NinjaLogReader::NinjaLogReader(const std::string &filename)
+    : filename_(filename),
+      file_(filename)
+{
+}
+
+NinjaLogReader::NinjaLogReader(const std::string &filename, size_t capacity)
+    : filename_(filename)
+{
+    file_.open(filename, capacity);
+}
+
+void NinjaLogReader::check_header() const
+{
+    std::string_view text = this->text();
+    if (text.length() == 0)
+    {
+        throw std::invalid_argument("Empty log file.");
+    }
+    std::string_view line = text.substr(0, text.find('\n'));
+    if (line.ends_with('\r'))
+    {
+        line.remove_suffix(1);
+    }
+    if (line != "# ninja log v5")
+    {
+        if (line.starts_with("# ninja log"))
+        {
+            throw std::invalid_argument("Invalid ninja log version. Expecting: '# ninja log v5'");
+        }
+        else
+        {
+            throw std::invalid_argument("Not a valid ninja file file.. Expecting: '# ninja log v5'");
+        }
+    }
+}
+
+std::vector<std::string_view> NinjaLogReader::chunks(std::string_view text, size_t maxChunks, size_t minChunkSize)
+{
+    std::vector<std::string_view> result;
+
+    size_t chunkCount = std::max((size_t)1, std::min(maxChunks, text.length() / std::max(minChunkSize, (size_t)1)));
+    size_t chunkSize = text.length() / chunkCount;
+
+    size_t pos = 0;
+    while (pos < text.length())
+    {
+        size_t end = text.length();
+        if (result.size() + 1 < chunkCount)
+        {
+            end = text.find('\n', pos + chunkSize);
+            end = (end == std::string_view::npos) ? text.length() : end + 1;
+        }
+        result.push_back(text.substr(pos, end - pos));
+        pos = end;
+    }
+    return result;
+}
+
+std::ostream &operator<<(std::ostream &s, const NinjaRecord &record)
+{
+    s << record.start_time_ms
+      << '\t' << record.end_time_ms
+      << '\t' << record.mtime
+      << '\t' << record.file_name
+      << '\t' << record.extra;
+    return s;
+}
@@ -0,0 +1,182 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "mapped_file.hpp"
+#include "delimiter_scanner.hpp"
+#include "literal_prefilter.hpp"
+
+// A non-owning view of one record of a .ninja_log file.
+//
+// file_name and extra point into the buffer the record was parsed from.
+struct NinjaRecord {
+    uint64_t start_time_ms = 0;
+    uint64_t end_time_ms = 0;
+    uint64_t mtime = 0; // ninja_clock_t ticks since the epoch.
+    std::string_view file_name;
+    std::string_view extra;
+
+    uint64_t duration_ms() const { return end_time_ms - start_time_ms; }
+};
+
+std::ostream &operator<<(std::ostream &s, const NinjaRecord &record);
+
+// Parse a single (non-empty, non-comment) log line. Returns false if the line is malformed.
+bool parse_ninja_record(std::string_view line, NinjaRecord *record);
+
+// Parse the record whose line starts at p, in a single pass over the line.
+//
+// Returns a pointer to the start of the following line, or nullptr if the line is malformed.
+const char *parse_ninja_record(const char *p, const char *end, NinjaRecord *record);
+
+// Parses a buffer a block at a time, using a DelimiterScanner to locate all field and line
+// delimiters in the block in a single pass.
+class NinjaBlockParser {
+public:
+    NinjaBlockParser();
+    NinjaBlockParser(DelimiterScanner::Isa isa);
+
+    // Parses the complete lines at the start of [p,end) into records(), and returns a pointer to
+    // the first unparsed line. A final line with no trailing newline is parsed only when it is the
+    // last line in the buffer.
+    //
+    // Returns nullptr if a malformed line is found; records() then holds the records that preceded it,
+    // and error_line() points to the start of the malformed line.
+    const char *parse(const char *p, const char *end);
+
+    const std::vector<NinjaRecord> &records() const { return records_; }
+    const char *error_line() const { return errorLine_; }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    DelimiterScanner scanner_;
+    std::vector<uint32_t> positions_;
+    std::vector<NinjaRecord> records_;
+    const char *errorLine_ = nullptr;
+};
+
+// Throws a std::logic_error identifying the line that starts at `line`.
+[[noreturn]] void throw_ninja_format_error(const std::string &filename, const char *fileStart, const char *line);
+
+// A .ninja_log (or .ninja_log.history) file, mapped into memory.
+class NinjaLogReader {
+public:
+    NinjaLogReader(const std::string &filename);
+    // Maps a log that ninja is still appending to, with room for it to grow to capacity bytes.
+    NinjaLogReader(const std::string &filename, size_t capacity);
+
+    // Extends text() to records appended since the log was opened. Returns false if the log must be
+    // opened again (see MappedFile::refresh()).
+    bool refresh() { return file_.refresh(); }
+
+    // Throws if the file does not start with a "# ninja log v5" header.
+    void check_header() const;
+
+    const std::string &filename() const { return filename_; }
+    std::string_view text() const { return file_.text(); }
+    const MappedFile &file() const { return file_; }
+
+    // Splits the file into at most maxChunks newline-aligned chunks of at least minChunkSize bytes.
+    std::vector<std::string_view> chunks(size_t maxChunks, size_t minChunkSize = 1024 * 1024) const
+    {
+        return chunks(text(), maxChunks, minChunkSize);
+    }
+    // Splits part of the file into chunks.
+    static std::vector<std::string_view> chunks(std::string_view range, size_t maxChunks, size_t minChunkSize = 1024 * 1024);
+
+    // Calls fn(const NinjaRecord&) for each record in the file, skipping blank lines and comments.
+    template <typename FN>
+    void for_each(FN &&fn) const
+    {
+        for_each_record(text(), fn, filename_);
+    }
+
+    // Calls fn(const NinjaRecord&) for each record in a chunk of the file.
+    template <typename FN>
+    void for_each(std::string_view chunk, FN &&fn) const
+    {
+        for_each_record(chunk, fn, filename_, text().data());
+    }
+
+    // Calls fn(const NinjaRecord&) only for the records of a chunk on lines that pass prefilter.
+    // Other lines are skipped without being parsed (or validated). If prefilter wouldn't skip
+    // much of the chunk, every record is parsed and passed to fn instead.
+    template <typename FN>
+    void for_each(std::string_view chunk, const LiteralPrefilter &prefilter, FN &&fn) const
+    {
+        constexpr size_t SAMPLE_SIZE = 64 * 1024;
+        if (!prefilter.is_selective(chunk.substr(0, chunk.rfind('\n', SAMPLE_SIZE) + 1)))
+        {
+            for_each(chunk, fn);
+            return;
+        }
+        NinjaRecord record;
+        prefilter.for_each_line(
+            chunk,
+            [&](std::string_view line)
+            {
+                if (line.empty() || line[0] == '#')
+                {
+                    return;
+                }
+                if (!parse_ninja_record(line, &record))
+                {
+                    throw_ninja_format_error(filename_, text().data(), line.data());
+                }
+                fn(record);
+            });
+    }
+
+    // Throws std::logic_error, identifying filename and line number, if a line is malformed.
+    // Line numbers are counted from fileStart, which defaults to the start of text.
+    template <typename FN>
+    static void for_each_record(std::string_view text, FN &&fn, const std::string &filename = "", const char *fileStart = nullptr)
+    {
+        NinjaBlockParser parser;
+        const char *p = text.data();
+        const char *end = p + text.length();
+        while (p < end)
+        {
+            const char *next = parser.parse(p, end);
+            for (const NinjaRecord &record : parser.records())
+            {
+                fn(record);
+            }
+            if (next == nullptr)
+            {
+                throw_ninja_format_error(filename, fileStart ? fileStart : text.data(), parser.error_line());
+            }
+            p = next;
+        }
+    }
+
+private:
+    std::string filename_;
+    MappedFile file_;
+};
@@ -0,0 +1,135 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "ninja_log_set.hpp"
+#include "parallel.hpp"
+#include "ss.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+static constexpr const char *NINJA_LOG = ".ninja_log";
+
+std::vector<std::string> NinjaLogSet::find_logs(const std::vector<std::string> &paths)
+{
+    std::vector<std::string> result;
+    for (const std::string &path : paths)
+    {
+        if (!fs::is_directory(path))
+        {
+            if (!fs::exists(path))
+            {
+                throw std::invalid_argument(SS("File not found: " << path));
+            }
+            result.push_back(path);
+            continue;
+        }
+        std::vector<std::string> found;
+        if (fs::is_regular_file(fs::path(path) / NINJA_LOG))
+        {
+            found.push_back((fs::path(path) / NINJA_LOG).string());
+        }
+        else
+        {
+            std::error_code ec;
+            for (auto it = fs::recursive_directory_iterator(path, fs::directory_options::skip_permission_denied, ec);
+                 it != fs::recursive_directory_iterator();
+                 it.increment(ec))
+            {
+                if (ec)
+                {
+                    throw std::invalid_argument(SS("Can't read directory " << path << ": " << ec.message()));
+                }
+                if (!it->is_directory(ec))
+                {
+                    continue;
+                }
+                fs::path log = it->path() / NINJA_LOG;
+                if (it->path().filename().string().starts_with('.'))
+                {
+                    it.disable_recursion_pending();
+                }
+                else if (fs::is_regular_file(log, ec))
+                {
+                    found.push_back(log.string());
+                    it.disable_recursion_pending();
+                }
+            }
+        }
+        if (found.empty())
+        {
+            throw std::invalid_argument(SS("No " << NINJA_LOG << " files found in " << path));
+        }
+        std::sort(found.begin(), found.end());
+        result.insert(result.end(), found.begin(), found.end());
+    }
+    return result;
+}
+
+void NinjaLogSet::load(const std::vector<std::string> &paths, const GlobMatcher &matcher)
+{
+    filenames_ = find_logs(paths);
+    trees_.clear();
+    for (const std::string &filename : filenames_)
+    {
+        std::string tree = fs::path(filename).parent_path().string();
+        trees_.push_back(tree.empty() ? "." : tree);
+    }
+
+    // Several logs are loaded at once, each with a share of the threads, so that the serial parts
+    // of loading one log (opening and mapping it, merging its chunks) overlap with work on others.
+    size_t threads = resolve_thread_count(threads_);
+    size_t logThreads = std::min(threads, filenames_.size());
+    size_t threadsPerLog = std::max<size_t>(1, threads / std::max<size_t>(1, logThreads));
+    logs_ = std::vector<NinjaLog>(filenames_.size());
+    parallel_for(filenames_.size(), logThreads,
+        [&](size_t i)
+        {
+            logs_[i].set_threads(threadsPerLog);
+            logs_[i].set_top(top_);
+            logs_[i].load(filenames_[i], matcher);
+        });
+}
+
+std::vector<NinjaLogSet::TreeFile> NinjaLogSet::files(size_t top) const
+{
+    std::vector<TreeFile> result;
+    for (size_t i = 0; i < logs_.size(); ++i)
+    {
+        for (const NinjaFile &file : logs_[i].files())
+        {
+            result.push_back(TreeFile{i, &file});
+        }
+    }
+    auto slowerThan = [](const TreeFile &v1, const TreeFile &v2)
+    {
+        return v1.file->duration_ms() > v2.file->duration_ms();
+    };
+    if (top != 0 && top < result.size())
+    {
+        std::nth_element(result.begin(), result.begin() + top, result.end(), slowerThan);
+        result.resize(top);
+    }
+    std::sort(result.begin(), result.end(), slowerThan);
+    return result;
+}
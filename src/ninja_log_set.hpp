@@ -0,0 +1,67 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "ninja_log.hpp"
+
+// The .ninja_logs of several build trees, loaded concurrently.
+class NinjaLogSet {
+public:
+    // A file of one of the logs.
+    struct TreeFile {
+        size_t log;  // index of the log.
+        const NinjaFile *file;
+    };
+
+    // Number of threads shared by all of the logs. 0 (the default) uses one thread per core.
+    void set_threads(size_t threads) { threads_ = threads; }
+
+    // Keep only the top slowest files of each log. 0 (the default) keeps all files.
+    void set_top(size_t top) { top_ = top; }
+
+    // Paths that are directories are searched for .ninja_log files. The search doesn't descend
+    // into build trees (directories that contain a .ninja_log), or into hidden directories.
+    static std::vector<std::string> find_logs(const std::vector<std::string> &paths);
+
+    // Loads the logs in paths (see find_logs). Several logs are loaded at once, each with a share
+    // of the threads.
+    void load(const std::vector<std::string> &paths, const GlobMatcher &matcher);
+
+    size_t log_count() const { return filenames_.size(); }
+    const std::string &filename(size_t log) const { return filenames_[log]; }
+    // The directory that contains the log.
+    const std::string &tree(size_t log) const { return trees_[log]; }
+    const NinjaLog &log(size_t log) const { return logs_[log]; }
+
+    // The top slowest files of all logs. 0 returns all of them.
+    std::vector<TreeFile> files(size_t top) const;
+
+private:
+    size_t threads_ = 0;
+    size_t top_ = 0;
+    std::vector<std::string> filenames_;
+    std::vector<std::string> trees_;
+    std::vector<NinjaLog> logs_;
+};
@@ -0,0 +1,312 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Benchmark suite: times each phase of ninja_times over a synthetic log and history.
+//
+// Syntax: ninja_times_bench [options]
+//   --edges N          distinct outputs in the project (default: 20000).
+//   --depth N          directories in the path of each output (default: 4).
+//   --builds N         builds in the history (default: 20).
+//   --rebuild R        fraction of the edges rebuilt by each build (default: 0.25).
+//   --duplicates R     fraction of the log's records already in the history (default: 0.5).
+//   --threads N        threads used to load logs; 0 uses one per core (default: 0).
+//   --repeat N         runs of each benchmark; the fastest is reported (default: 3).
+//   --dir PATH         where the synthetic files are written (default: a temporary directory).
+//   --output FILE      append the results to FILE, as one line of JSON per run.
+//   --generate         only write the synthetic .ninja_log and .ninja_log.history to --dir.
+
+#include "CommandLineParser.hpp"
+#include "GlobMatcher.hpp"
+#include "ninja_log.hpp"
+#include "ninja_log_reader.hpp"
+#include "output_writer.hpp"
+#include "synthetic_log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct BenchmarkResult {
+    std::string name;
+    double seconds;  // fastest run.
+    size_t items;    // records, names or files processed by each run.
+    size_t bytes;    // input bytes processed by each run; 0 if not meaningful.
+};
+
+// Times fn `repeat` times, calling setup (untimed) before each run.
+static double fastest(size_t repeat, const std::function<void()> &setup, const std::function<void()> &fn)
+{
+    using clock_t = std::chrono::steady_clock;
+    double best = 0;
+    for (size_t i = 0; i < std::max<size_t>(repeat, 1); ++i)
+    {
+        setup();
+        auto start = clock_t::now();
+        fn();
+        double seconds = std::chrono::duration<double>(clock_t::now() - start).count();
+        best = (i == 0) ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+static void writeJson(std::ostream &s, const SyntheticLogOptions &options, size_t threads, const std::vector<BenchmarkResult> &results)
+{
+    std::time_t now = std::time(nullptr);
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    s << "{\"time\":\"" << timestamp << "\""
+      << ",\"edges\":" << options.edges
+      << ",\"depth\":" << options.depth
+      << ",\"builds\":" << options.builds
+      << ",\"rebuild\":" << options.rebuild_ratio
+      << ",\"duplicates\":" << options.duplicate_ratio
+      << ",\"threads\":" << threads
+      << ",\"benchmarks\":[";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult &result = results[i];
+        s << (i == 0 ? "" : ",")
+          << "{\"name\":\"" << result.name << "\""
+          << ",\"seconds\":" << std::setprecision(6) << result.seconds
+          << ",\"items\":" << result.items
+          << ",\"bytes\":" << result.bytes
+          << ",\"items_per_second\":" << std::setprecision(0) << std::fixed << result.items / result.seconds
+          << std::defaultfloat << "}";
+    }
+    s << "]}" << '\n';
+}
+
+int main(int argc, const char **argv)
+{
+    SyntheticLogOptions options;
+    size_t threads = 0;
+    size_t repeat = 3;
+    std::string directory = (std::filesystem::temp_directory_path() / "ninja_times_bench").string();
+    std::string output;
+    bool generateOnly = false;
+    try
+    {
+        twoplay::CommandLineParser parser;
+        parser.AddOption("--edges", &options.edges);
+        parser.AddOption("--depth", &options.depth);
+        parser.AddOption("--builds", &options.builds);
+        parser.AddOption("--rebuild", &options.rebuild_ratio);
+        parser.AddOption("--duplicates", &options.duplicate_ratio);
+        parser.AddOption("--threads", &threads);
+        parser.AddOption("--repeat", &repeat);
+        parser.AddOption("--dir", &directory);
+        parser.AddOption("--output", &output);
+        parser.AddOption("--generate", &generateOnly);
+        parser.Parse(argc, argv);
+        if (parser.ArgumentCount() != 0)
+        {
+            throw std::logic_error("Unexpected argument: " + parser.Argument(0));
+        }
+
+        cout << "Generating " << options.edges << " edges, " << options.builds << " builds..." << endl;
+        SyntheticLog synthetic(options);
+        std::filesystem::create_directories(directory);
+        std::string logFile = (std::filesystem::path(directory) / "bench.ninja_log").string();
+        synthetic.write(logFile);
+        cout << "   " << logFile << ": " << synthetic.log_record_count() << " records, "
+             << synthetic.history_record_count() << " in the history." << endl;
+        if (generateOnly)
+        {
+            return EXIT_SUCCESS;
+        }
+
+        std::vector<BenchmarkResult> results;
+        auto noSetup = []() {};
+        auto restore = [&]()
+        {
+            synthetic.write(logFile);
+        };
+        const GlobMatcher matchAll;
+        const GlobMatcher matchNothing({}, {"*"});
+
+        // Parsing records into NinjaFiles.
+        results.push_back({"parse_log",
+            fastest(repeat, noSetup,
+                [&]()
+                {
+                    NinjaLogReader reader(logFile);
+                    std::vector<NinjaFile> files;
+                    reader.for_each(
+                        [&](const NinjaRecord &record)
+                        {
+                            files.push_back(NinjaFile(record));
+                        });
+                }),
+            synthetic.log_record_count(), synthetic.log().size()});
+
+        // Matching each distinct file name against patterns of each shape.
+        const std::vector<std::string> patterns = {"*.cpp.o", "src/dir1/*", "*/dir2/*", "*File1?3.c*", synthetic.file_names()[synthetic.file_names().size() / 2]};
+        std::vector<GlobMatcher> matchers(patterns.begin(), patterns.end());
+        size_t matches = 0;
+        results.push_back({"glob_match",
+            fastest(repeat, noSetup,
+                [&]()
+                {
+                    for (const GlobMatcher &matcher : matchers)
+                    {
+                        for (const std::string &name : synthetic.file_names())
+                        {
+                            matches += matcher.Matches(name);
+                        }
+                    }
+                }),
+            matchers.size() * synthetic.file_names().size(), 0});
+
+        // Loading the log: parse, keep the latest record of each file, sort.
+        NinjaLog log;
+        results.push_back({"log_load",
+            fastest(repeat, noSetup,
+                [&]()
+                {
+                    log = NinjaLog();
+                    log.set_threads(threads);
+                    log.load(logFile, matchAll);
+                }),
+            synthetic.log_record_count(), synthetic.log().size()});
+
+        // Sorting files by duration.
+        std::vector<NinjaFile> files = log.files();
+        results.push_back({"sort",
+            fastest(repeat,
+                [&]()
+                {
+                    std::shuffle(files.begin(), files.end(), std::mt19937_64(1));
+                },
+                [&]()
+                {
+                    std::sort(files.begin(), files.end());
+                }),
+            files.size(), 0});
+
+        // Merging the log into the history, removing records that are already in it.
+        results.push_back({"history_merge",
+            fastest(repeat, restore,
+                [&]()
+                {
+                    NinjaHistory history;
+                    history.set_threads(threads);
+                    history.set_format(HistoryFormat::Text);
+                    history.load(logFile, matchNothing);
+                }),
+            synthetic.log_record_count() + synthetic.history_record_count(), synthetic.log().size() + synthetic.history().size()});
+
+        // Rewriting the history without duplicates.
+        results.push_back({"history_compact",
+            fastest(repeat, restore,
+                [&]()
+                {
+                    NinjaHistory history;
+                    history.set_threads(threads);
+                    history.set_format(HistoryFormat::Text);
+                    history.set_compact(true);
+                    history.load(logFile, matchNothing);
+                }),
+            synthetic.log_record_count() + synthetic.history_record_count(), synthetic.log().size() + synthetic.history().size()});
+
+        // Loading the history of every file.
+        NinjaHistory history;
+        results.push_back({"history_load",
+            fastest(repeat, restore,
+                [&]()
+                {
+                    history = NinjaHistory();
+                    history.set_threads(threads);
+                    history.set_format(HistoryFormat::Text);
+                    history.load(logFile, matchAll);
+                }),
+            synthetic.log_record_count() + synthetic.history_record_count(), synthetic.log().size() + synthetic.history().size()});
+
+        // Writing the default listing, and the history, to /dev/null.
+        results.push_back({"output_log",
+            fastest(repeat, noSetup,
+                [&]()
+                {
+                    std::ofstream s("/dev/null");
+                    OutputWriter out(s);
+                    for (const auto &file : log.files())
+                    {
+                        out.write_fixed(file.duration_ms() / 1000.00, 3, 8);
+                        out.put(' ');
+                        out.write(file.file_name());
+                        out.put('\n');
+                    }
+                }),
+            log.files().size(), 0});
+        results.push_back({"output_history",
+            fastest(repeat, noSetup,
+                [&]()
+                {
+                    std::ofstream s("/dev/null");
+                    s << history;
+                }),
+            history.record_count(), 0});
+
+        cout << setw(18) << "benchmark" << setw(12) << "ms" << setw(14) << "items/s" << setw(10) << "MB/s" << endl;
+        for (const BenchmarkResult &result : results)
+        {
+            cout << setw(18) << result.name
+                 << setw(12) << setprecision(2) << fixed << result.seconds * 1000
+                 << setw(14) << setprecision(0) << result.items / result.seconds;
+            if (result.bytes != 0)
+            {
+                cout << setw(10) << result.bytes / (1024.0 * 1024.0) / result.seconds;
+            }
+            cout << endl;
+        }
+        if (matches == 0)
+        {
+            throw std::logic_error("No file names matched.");
+        }
+
+        if (!output.empty())
+        {
+            std::ofstream f(output, std::ios_base::app);
+            if (!f.is_open())
+            {
+                throw std::invalid_argument("Can't open file " + output);
+            }
+            writeJson(f, options, threads, results);
+            cout << "Results appended to " << output << endl;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        cout << "Error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "output_writer.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+size_t LocalTimeFormatter::format(std::time_t time, char *out)
+{
+    constexpr std::time_t QUARTER_HOUR = 15 * 60;
+
+    std::time_t start = time - ((time % QUARTER_HOUR) + QUARTER_HOUR) % QUARTER_HOUR;
+    if (!valid_ || start != start_)
+    {
+        struct tm first, last;
+        std::time_t end = start + QUARTER_HOUR - 1;
+        localtime_r(&start, &first);
+        localtime_r(&end, &last);
+        valid_ = true;
+        start_ = start;
+        uniform_ = first.tm_gmtoff == last.tm_gmtoff && first.tm_sec == 0 && first.tm_min % 15 == 0;
+        prefixLength_ = strftime(prefix_, sizeof(prefix_), "%Y-%m-%d %H:", &first);
+        minute_ = first.tm_min;
+    }
+    if (!uniform_ || prefixLength_ == 0)
+    {
+        struct tm local;
+        localtime_r(&time, &local);
+        return strftime(out, MAX_LENGTH, "%Y-%m-%d %H:%M:%S", &local);
+    }
+    int offset = (int)(time - start_);
+    int minute = minute_ + offset / 60;
+    int second = offset % 60;
+    memcpy(out, prefix_, prefixLength_);
+    char *p = out + prefixLength_;
+    *p++ = (char)('0' + minute / 10);
+    *p++ = (char)('0' + minute % 10);
+    *p++ = ':';
+    *p++ = (char)('0' + second / 10);
+    *p++ = (char)('0' + second % 10);
+    return p - out;
+}
+
+OutputWriter::OutputWriter(std::ostream &s, size_t bufferSize)
+    : s_(s), buffer_(std::max<size_t>(bufferSize, 256))
+{
+}
+
+OutputWriter::~OutputWriter()
+{
+    flush();
+}
+
+void OutputWriter::flush()
+{
+    if (size_ != 0)
+    {
+        s_.write(buffer_.data(), size_);
+        size_ = 0;
+    }
+}
+
+void OutputWriter::write(std::string_view text)
+{
+    if (text.length() > buffer_.size() - size_)
+    {
+        flush();
+        if (text.length() > buffer_.size())
+        {
+            s_.write(text.data(), text.length());
+            return;
+        }
+    }
+    memcpy(buffer_.data() + size_, text.data(), text.length());
+    size_ += text.length();
+}
+
+void OutputWriter::write_right(std::string_view text, size_t width)
+{
+    for (size_t i = text.length(); i < width; ++i)
+    {
+        put(' ');
+    }
+    write(text);
+}
+
+void OutputWriter::write_uint(uint64_t value, size_t width)
+{
+    char text[24];
+    auto result = std::to_chars(text, text + sizeof(text), value);
+    write_right(std::string_view(text, result.ptr - text), width);
+}
+
+void OutputWriter::write_fixed(double value, int precision, size_t width)
+{
+    char text[400]; // enough for any double, in fixed notation.
+    auto result = std::to_chars(text, text + sizeof(text), value, std::chars_format::fixed, precision);
+    write_right(std::string_view(text, result.ptr - text), width);
+}
+
+void OutputWriter::write_time(const std::chrono::system_clock::time_point &time, size_t width)
+{
+    char text[LocalTimeFormatter::MAX_LENGTH];
+    size_t length = timeFormatter_.format(std::chrono::system_clock::to_time_t(time), text);
+    write_right(std::string_view(text, length), width);
+}
@@ -0,0 +1,121 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+// Restores a stream's format flags, precision and fill character when it goes out of scope, so that
+// an operator<< that sets them doesn't change how the caller's later output is formatted.
+class StreamFormatGuard {
+public:
+    StreamFormatGuard(std::ostream &s)
+        : s_(s),
+          flags_(s.flags()),
+          precision_(s.precision()),
+          fill_(s.fill())
+    {
+    }
+    ~StreamFormatGuard()
+    {
+        s_.flags(flags_);
+        s_.precision(precision_);
+        s_.fill(fill_);
+    }
+
+    StreamFormatGuard(const StreamFormatGuard &) = delete;
+    StreamFormatGuard &operator=(const StreamFormatGuard &) = delete;
+
+private:
+    std::ostream &s_;
+    std::ios_base::fmtflags flags_;
+    std::streamsize precision_;
+    char fill_;
+};
+
+// Formats times as local "YYYY-MM-DD HH:MM:SS".
+//
+// localtime_r is called once per quarter hour of time, rather than once per call: time zone offsets
+// are multiples of 15 minutes, and change on quarter-hour boundaries, so the local time of any second
+// in a quarter hour follows from the local time at its start. Quarter hours in which the offset isn't
+// uniform (historical local mean time) fall back to localtime_r.
+class LocalTimeFormatter {
+public:
+    static constexpr size_t MAX_LENGTH = 32;
+
+    // Writes the formatted time to out, which must have room for MAX_LENGTH characters, and returns
+    // its length.
+    size_t format(std::time_t time, char *out);
+
+private:
+    bool valid_ = false;
+    bool uniform_ = false;
+    std::time_t start_ = 0;
+    char prefix_[MAX_LENGTH];  // "YYYY-MM-DD HH:" at start_.
+    size_t prefixLength_ = 0;
+    int minute_ = 0;           // minute at start_.
+};
+
+// Formats text into a large buffer, and writes it to a stream a buffer at a time, so that
+// output takes a few large writes rather than one per row.
+//
+// Numbers are formatted with std::to_chars, rather than through the stream's locale and
+// formatting flags. Widths right-align a value in that many columns, as setw does.
+class OutputWriter {
+public:
+    OutputWriter(std::ostream &s, size_t bufferSize = 1024 * 1024);
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter &) = delete;
+    OutputWriter &operator=(const OutputWriter &) = delete;
+
+    void put(char c)
+    {
+        if (size_ == buffer_.size())
+        {
+            flush();
+        }
+        buffer_[size_++] = c;
+    }
+    void write(std::string_view text);
+    void write_right(std::string_view text, size_t width);
+
+    void write_uint(uint64_t value, size_t width = 0);
+    // value, with precision digits after the decimal point (as std::fixed).
+    void write_fixed(double value, int precision, size_t width = 0);
+    // Local time, as "YYYY-MM-DD HH:MM:SS".
+    void write_time(const std::chrono::system_clock::time_point &time, size_t width = 0);
+
+    // Writes the buffer to the stream. The stream itself is not flushed.
+    void flush();
+
+private:
+    std::ostream &s_;
+    std::vector<char> buffer_;
+    size_t size_ = 0;
+    LocalTimeFormatter timeFormatter_;
+};
@@ -0,0 +1,172 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "path_rollup.hpp"
+#include "output_writer.hpp"
+#include "ss.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+
+static constexpr std::string_view NO_TARGET = "(no target)";
+static constexpr std::string_view NO_EXTENSION = "(no extension)";
+
+PathRollup::PathRollup(GroupBy groupBy)
+    : groupBy_(groupBy)
+{
+    nodes_.push_back(Node{segments_.intern(""), 0});
+}
+
+PathRollup::GroupBy PathRollup::parse_group_by(std::string_view value)
+{
+    if (value == "dir")
+    {
+        return GroupBy::Directory;
+    }
+    if (value == "target")
+    {
+        return GroupBy::Target;
+    }
+    if (value == "ext")
+    {
+        return GroupBy::Extension;
+    }
+    throw std::invalid_argument(SS("--group-by must be one of: dir, target, ext. (" << value << ")"));
+}
+
+// Appends the directory segments of path (with their trailing '/') to segments.
+static void splitDirectories(std::string_view path, std::vector<std::string_view> &segments)
+{
+    size_t start = 0;
+    size_t slash;
+    while ((slash = path.find('/', start)) != std::string_view::npos)
+    {
+        segments.push_back(path.substr(start, slash + 1 - start));
+        start = slash + 1;
+    }
+}
+
+void PathRollup::key_path(std::string_view fileName, std::vector<std::string_view> &path) const
+{
+    path.clear();
+    switch (groupBy_)
+    {
+    case GroupBy::Directory:
+        splitDirectories(fileName, path);
+        break;
+    case GroupBy::Target:
+    {
+        constexpr std::string_view CMAKE_FILES = "CMakeFiles/";
+        size_t targetStart = std::string_view::npos;
+        if (fileName.starts_with(CMAKE_FILES))
+        {
+            targetStart = CMAKE_FILES.length();
+        }
+        else if (size_t pos = fileName.find("/CMakeFiles/"); pos != std::string_view::npos)
+        {
+            targetStart = pos + 1 + CMAKE_FILES.length();
+        }
+        size_t targetEnd = targetStart == std::string_view::npos ? std::string_view::npos : fileName.find(".dir/", targetStart);
+        if (targetEnd == std::string_view::npos)
+        {
+            path.push_back(NO_TARGET);
+            splitDirectories(fileName, path);
+        }
+        else
+        {
+            path.push_back(fileName.substr(targetStart, targetEnd - targetStart));
+            splitDirectories(fileName.substr(targetEnd + sizeof(".dir/") - 1), path);
+        }
+        break;
+    }
+    case GroupBy::Extension:
+    {
+        size_t slash = fileName.rfind('/');
+        std::string_view name = slash == std::string_view::npos ? fileName : fileName.substr(slash + 1);
+        size_t dot = name.find('.', 1); // a leading '.' marks a hidden file, not an extension.
+        path.push_back(dot == std::string_view::npos ? NO_EXTENSION : name.substr(dot));
+        splitDirectories(fileName, path);
+        break;
+    }
+    }
+}
+
+uint32_t PathRollup::child(uint32_t parent, std::string_view segment)
+{
+    uint32_t segmentId = segments_.intern(segment);
+    auto result = childIndex_.try_emplace(((uint64_t)parent << 32) | segmentId, (uint32_t)nodes_.size());
+    if (result.second)
+    {
+        nodes_.push_back(Node{segmentId, parent});
+        nodes_[parent].children.push_back(result.first->second);
+    }
+    return result.first->second;
+}
+
+void PathRollup::add(std::string_view fileName, uint64_t durationMs)
+{
+    key_path(fileName, path_);
+    uint32_t node = 0;
+    for (size_t i = 0; ; ++i)
+    {
+        Node &n = nodes_[node];
+        n.total_ms += durationMs;
+        n.file_count += 1;
+        n.slowest_ms = std::max(n.slowest_ms, durationMs);
+        if (i == path_.size())
+        {
+            break;
+        }
+        node = child(node, path_[i]);
+    }
+}
+
+static void writeNode(std::ostream &s, const PathRollup &rollup, uint32_t nodeIndex, size_t level)
+{
+    const PathRollup::Node &node = rollup.nodes()[nodeIndex];
+    s << std::setw(12) << node.total_ms / 1000.0 << std::setw(10) << node.slowest_ms / 1000.0
+      << std::setw(8) << node.file_count << "  " << std::string(level * 2, ' ')
+      << (nodeIndex == 0 ? std::string_view("(total)") : rollup.segment(node.segment)) << '\n';
+    if (rollup.depth() != 0 && level >= rollup.depth())
+    {
+        return;
+    }
+    std::vector<uint32_t> children = node.children;
+    std::sort(children.begin(), children.end(),
+        [&](uint32_t a, uint32_t b)
+        {
+            return rollup.nodes()[a].total_ms > rollup.nodes()[b].total_ms;
+        });
+    for (uint32_t child : children)
+    {
+        writeNode(s, rollup, child, level + 1);
+    }
+}
+
+std::ostream &operator<<(std::ostream &s, const PathRollup &rollup)
+{
+    StreamFormatGuard formatGuard(s);
+    s << std::setprecision(3) << std::fixed;
+    s << std::setw(12) << "total" << std::setw(10) << "slowest" << std::setw(8) << "files" << "  path" << '\n';
+    writeNode(s, rollup, 0, 0);
+    return s;
+}
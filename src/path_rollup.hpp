@@ -0,0 +1,84 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "string_interner.hpp"
+
+// Totals of build times, rolled up through a tree of path segments.
+//
+// Each file's duration is added to every node on its key path, so each node holds the subtotal of
+// its subtree. Path segments are interned, and nodes are found by (parent, segment ID), so
+// directories shared by many files are stored once.
+class PathRollup {
+public:
+    enum class GroupBy {
+        Directory,  // src/ > CMakeFiles/ > libpipedald.dir/
+        Target,     // the CMake target (CMakeFiles/<target>.dir/), then directories within the target.
+        Extension   // .cpp.o, then directories.
+    };
+
+    struct Node {
+        uint32_t segment = 0;  // ID in segments().
+        uint32_t parent = 0;
+        uint64_t total_ms = 0;
+        uint64_t file_count = 0;
+        uint64_t slowest_ms = 0;
+        std::vector<uint32_t> children = {};
+    };
+
+    PathRollup(GroupBy groupBy);
+
+    // Parses a --group-by value: dir, target or ext.
+    static GroupBy parse_group_by(std::string_view value);
+
+    // Display only nodes this many levels below the root. 0 (the default) displays all levels.
+    void set_depth(size_t depth) { depth_ = depth; }
+    size_t depth() const { return depth_; }
+
+    void add(std::string_view fileName, uint64_t durationMs);
+
+    // nodes()[0] is the root, which holds the grand total.
+    const std::vector<Node> &nodes() const { return nodes_; }
+    std::string_view segment(uint32_t segmentId) const { return segments_.str(segmentId); }
+
+private:
+    // Splits a file name into the segments of its key path.
+    void key_path(std::string_view fileName, std::vector<std::string_view> &path) const;
+
+    uint32_t child(uint32_t parent, std::string_view segment);
+
+    GroupBy groupBy_;
+    size_t depth_ = 0;
+    StringInterner segments_;
+    std::vector<Node> nodes_;
+    std::unordered_map<uint64_t, uint32_t> childIndex_; // (parent << 32 | segment) -> node.
+    std::vector<std::string_view> path_;
+};
+
+// An indented tree, with the children of each node ordered by total time, largest first.
+std::ostream &operator<<(std::ostream &s, const PathRollup &rollup);
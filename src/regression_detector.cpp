@@ -0,0 +1,241 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "regression_detector.hpp"
+#include "output_writer.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+
+QuantileEstimator::QuantileEstimator(double quantile)
+    : quantile_(quantile)
+{
+    if (quantile <= 0 || quantile >= 1)
+    {
+        throw std::invalid_argument("Quantile must be between 0 and 1.");
+    }
+    double desired[5] = {0, 2 * quantile, 4 * quantile, 2 + 2 * quantile, 4};
+    double increments[5] = {0, quantile / 2, quantile, (1 + quantile) / 2, 1};
+    for (size_t i = 0; i < 5; ++i)
+    {
+        positions_[i] = (double)i;
+        desiredPositions_[i] = desired[i];
+        increments_[i] = increments[i];
+    }
+}
+
+void QuantileEstimator::add(double value)
+{
+    if (count_ < 5)
+    {
+        // the first five values are the initial marker heights, kept sorted.
+        size_t i = count_++;
+        for (; i > 0 && heights_[i - 1] > value; --i)
+        {
+            heights_[i] = heights_[i - 1];
+        }
+        heights_[i] = value;
+        return;
+    }
+    ++count_;
+
+    size_t cell;
+    if (value < heights_[0])
+    {
+        heights_[0] = value;
+        cell = 0;
+    }
+    else if (value >= heights_[4])
+    {
+        heights_[4] = value;
+        cell = 3;
+    }
+    else
+    {
+        cell = 0;
+        while (value >= heights_[cell + 1])
+        {
+            ++cell;
+        }
+    }
+    for (size_t i = cell + 1; i < 5; ++i)
+    {
+        positions_[i] += 1;
+    }
+    for (size_t i = 0; i < 5; ++i)
+    {
+        desiredPositions_[i] += increments_[i];
+    }
+
+    // move the middle markers towards their desired positions, one position at a time.
+    for (size_t i = 1; i < 4; ++i)
+    {
+        double offset = desiredPositions_[i] - positions_[i];
+        if ((offset >= 1 && positions_[i + 1] - positions_[i] > 1) || (offset <= -1 && positions_[i - 1] - positions_[i] < -1))
+        {
+            double d = offset > 0 ? 1 : -1;
+            double parabolic = heights_[i] + d / (positions_[i + 1] - positions_[i - 1]) *
+                                                 ((positions_[i] - positions_[i - 1] + d) * (heights_[i + 1] - heights_[i]) / (positions_[i + 1] - positions_[i]) +
+                                                  (positions_[i + 1] - positions_[i] - d) * (heights_[i] - heights_[i - 1]) / (positions_[i] - positions_[i - 1]));
+            if (heights_[i - 1] < parabolic && parabolic < heights_[i + 1])
+            {
+                heights_[i] = parabolic;
+            }
+            else
+            {
+                size_t j = d > 0 ? i + 1 : i - 1;
+                heights_[i] += d * (heights_[j] - heights_[i]) / (positions_[j] - positions_[i]);
+            }
+            positions_[i] += d;
+        }
+    }
+}
+
+double QuantileEstimator::estimate() const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+    if (count_ <= 5)
+    {
+        // exact, interpolating between the sorted values.
+        double position = quantile_ * (count_ - 1);
+        size_t below = (size_t)position;
+        if (below + 1 >= count_)
+        {
+            return heights_[count_ - 1];
+        }
+        return heights_[below] + (position - below) * (heights_[below + 1] - heights_[below]);
+    }
+    return heights_[2];
+}
+
+static double median(double *values, size_t count)
+{
+    std::sort(values, values + count);
+    return count % 2 == 1 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+void RegressionDetector::analyze(const NinjaHistory &history)
+{
+    // the recent builds are kept in a fixed-size buffer.
+    constexpr size_t MAX_RECENT_COUNT = 32;
+    if (recentCount_ < 1 || recentCount_ > MAX_RECENT_COUNT)
+    {
+        throw std::invalid_argument("The number of recent builds must be between 1 and 32.");
+    }
+
+    const std::vector<NinjaFileHistory> &fileHistories = history.file_histories();
+    std::vector<Regression> results(fileHistories.size());
+    std::vector<uint8_t> found(fileHistories.size());
+    std::vector<uint8_t> analyzed(fileHistories.size());
+    parallel_for(fileHistories.size(), resolve_thread_count(threads_),
+        [&](size_t i)
+        {
+            const std::vector<NinjaFileHistoryEntry> &entries = fileHistories[i].entries();
+            if (entries.size() < MIN_BASELINE_COUNT + recentCount_)
+            {
+                return;
+            }
+            analyzed[i] = true;
+
+            // one pass over the entries, oldest first.
+            size_t baselineCount = entries.size() - recentCount_;
+            QuantileEstimator baseline;
+            QuantileEstimator deviation;
+            double recent[MAX_RECENT_COUNT];
+            for (size_t j = 0; j < entries.size(); ++j)
+            {
+                double duration = (double)entries[j].duration_ms();
+                if (j < baselineCount)
+                {
+                    baseline.add(duration);
+                    deviation.add(std::abs(duration - baseline.estimate()));
+                }
+                else
+                {
+                    recent[j - baselineCount] = duration;
+                }
+            }
+
+            Regression &result = results[i];
+            result.baseline_ms = baseline.estimate();
+            result.recent_ms = median(recent, recentCount_);
+            // a file whose build time never varies would otherwise flag any change at all.
+            result.spread_ms = std::max({deviation.estimate(), result.baseline_ms * 0.01, 1.0});
+            result.score = 0.6745 * result.added_ms() / result.spread_ms;
+            result.sample_count = entries.size();
+            if (result.score > threshold_ && result.added_ms() >= minAddedMs_ && result.added_ms() >= result.baseline_ms * minAddedRatio_)
+            {
+                result.file_name = fileHistories[i].filename();
+                found[i] = true;
+            }
+        });
+
+    regressions_.clear();
+    analyzedCount_ = 0;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        analyzedCount_ += analyzed[i];
+        if (found[i])
+        {
+            regressions_.push_back(std::move(results[i]));
+        }
+    }
+    std::sort(regressions_.begin(), regressions_.end(),
+        [](const Regression &v1, const Regression &v2)
+        {
+            return v1.added_ms() > v2.added_ms();
+        });
+    regressionCount_ = regressions_.size();
+    if (top_ != 0 && top_ < regressions_.size())
+    {
+        regressions_.resize(top_);
+    }
+}
+
+std::ostream &operator<<(std::ostream &s, const RegressionDetector &detector)
+{
+    StreamFormatGuard formatGuard(s);
+    s << detector.regression_count() << " of " << detector.analyzed_count() << " files have regressed." << '\n';
+    if (detector.regressions().empty())
+    {
+        return s;
+    }
+    s << std::setw(10) << "added" << std::setw(10) << "baseline" << std::setw(10) << "recent"
+      << std::setw(10) << "mad" << std::setw(8) << "score" << std::setw(8) << "builds" << "  file" << '\n';
+    for (const RegressionDetector::Regression &regression : detector.regressions())
+    {
+        s << std::setprecision(3) << std::fixed
+          << std::setw(10) << regression.added_ms() / 1000.0
+          << std::setw(10) << regression.baseline_ms / 1000.0
+          << std::setw(10) << regression.recent_ms / 1000.0
+          << std::setw(10) << regression.spread_ms / 1000.0
+          << std::setprecision(1)
+          << std::setw(8) << regression.score
+          << std::setw(8) << regression.sample_count
+          << "  " << regression.file_name << '\n';
+    }
+    return s;
+}
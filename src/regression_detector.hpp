@@ -0,0 +1,115 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ninja_log.hpp"
+
+// Streaming estimate of one quantile of a sequence of values, using the P-square algorithm
+// (Jain and Chlamtac, 1985): five markers whose heights are adjusted as values arrive, without
+// storing the values. Exact until five values have been added.
+class QuantileEstimator {
+public:
+    QuantileEstimator(double quantile = 0.5);
+
+    void add(double value);
+
+    size_t count() const { return count_; }
+    double estimate() const;
+
+private:
+    double quantile_;
+    size_t count_ = 0;
+    double heights_[5];
+    double positions_[5];
+    double desiredPositions_[5];
+    double increments_[5];
+};
+
+// Finds files whose recent build times are significantly slower than their history.
+//
+// Each file's baseline is all but its most recent builds. The baseline is summarized by its median
+// and median absolute deviation (MAD), both estimated in a single pass with O(1) state, so the
+// median and deviation are robust against the occasional very slow build (e.g. on a busy machine).
+// A file has regressed if the median of its recent builds is more than threshold MADs above the
+// baseline median (a modified z-score), and the slowdown is large enough to matter.
+class RegressionDetector {
+public:
+    struct Regression {
+        std::string file_name;
+        double baseline_ms;  // median of the baseline.
+        double spread_ms;    // MAD of the baseline.
+        double recent_ms;    // median of the recent builds.
+        double score;        // modified z-score.
+        size_t sample_count;
+
+        double added_ms() const { return recent_ms - baseline_ms; }
+    };
+
+    // Number of threads used for the analysis. 0 (the default) uses one thread per core.
+    void set_threads(size_t threads) { threads_ = threads; }
+
+    // Number of most recent builds that are compared with the baseline. Default: 3.
+    void set_recent_count(size_t recentCount) { recentCount_ = recentCount; }
+
+    // Modified z-score above which a slowdown is significant. Default: 3.5.
+    void set_threshold(double threshold) { threshold_ = threshold; }
+
+    // Slowdowns smaller than this many ms, or than this fraction of the baseline, are ignored.
+    // Defaults: 500ms, 10%.
+    void set_min_added_ms(double minAddedMs) { minAddedMs_ = minAddedMs; }
+    void set_min_added_ratio(double minAddedRatio) { minAddedRatio_ = minAddedRatio; }
+
+    // Keep only the top regressions. 0 (the default) keeps all of them.
+    void set_top(size_t top) { top_ = top; }
+
+    void analyze(const NinjaHistory &history);
+
+    // Largest slowdown first.
+    const std::vector<Regression> &regressions() const { return regressions_; }
+
+    // Files that have regressed, including any beyond the top.
+    size_t regression_count() const { return regressionCount_; }
+
+    // Files that have enough builds to be analyzed.
+    size_t analyzed_count() const { return analyzedCount_; }
+
+private:
+    // Fewer baseline builds than this can't establish what is normal for a file.
+    static constexpr size_t MIN_BASELINE_COUNT = 5;
+
+    size_t threads_ = 0;
+    size_t recentCount_ = 3;
+    double threshold_ = 3.5;
+    double minAddedMs_ = 500;
+    double minAddedRatio_ = 0.1;
+    size_t top_ = 0;
+    size_t analyzedCount_ = 0;
+    size_t regressionCount_ = 0;
+    std::vector<Regression> regressions_;
+};
+
+std::ostream &operator<<(std::ostream &s, const RegressionDetector &detector);
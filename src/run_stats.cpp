@@ -0,0 +1,110 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "run_stats.hpp"
+#include "output_writer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sys/resource.h>
+
+RunStats &RunStats::instance()
+{
+    static RunStats stats;
+    return stats;
+}
+
+void RunStats::add_time(const char *phase, double seconds)
+{
+    std::lock_guard lock(mutex_);
+    auto it = std::find_if(phases_.begin(), phases_.end(), [&](const Phase &p) { return strcmp(p.name, phase) == 0; });
+    if (it == phases_.end())
+    {
+        phases_.push_back(Phase{phase, seconds, 1});
+    }
+    else
+    {
+        it->seconds += seconds;
+        ++it->calls;
+    }
+}
+
+void RunStats::add_count(const char *counter, uint64_t value)
+{
+    std::lock_guard lock(mutex_);
+    auto it = std::find_if(counters_.begin(), counters_.end(), [&](const Counter &c) { return strcmp(c.name, counter) == 0; });
+    if (it == counters_.end())
+    {
+        counters_.push_back(Counter{counter, value});
+    }
+    else
+    {
+        it->value += value;
+    }
+}
+
+uint64_t RunStats::peak_rss()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+    return (uint64_t)usage.ru_maxrss * 1024; // kilobytes on Linux.
+}
+
+void RunStats::write(std::ostream &s, double totalSeconds) const
+{
+    std::lock_guard lock(mutex_);
+    StreamFormatGuard formatGuard(s);
+    s << std::left << std::setw(28) << "phase" << std::right << std::setw(12) << "ms" << std::setw(8) << "calls" << '\n';
+    for (const Phase &phase : phases_)
+    {
+        s << std::left << std::setw(28) << phase.name << std::right
+          << std::setw(12) << std::setprecision(2) << std::fixed << phase.seconds * 1000
+          << std::setw(8) << phase.calls << '\n';
+    }
+    s << std::left << std::setw(28) << "total" << std::right << std::setw(12) << totalSeconds * 1000 << '\n';
+    s << '\n';
+    for (const Counter &counter : counters_)
+    {
+        s << std::left << std::setw(28) << counter.name << std::right << std::setw(20) << counter.value << '\n';
+    }
+    s << std::left << std::setw(28) << "peak_rss_bytes" << std::right << std::setw(20) << peak_rss() << '\n';
+}
+
+void RunStats::write_json(std::ostream &s, double totalSeconds) const
+{
+    std::lock_guard lock(mutex_);
+    StreamFormatGuard formatGuard(s);
+    s << "{\"total_seconds\":" << std::setprecision(6) << totalSeconds << ",\"phases\":[";
+    for (size_t i = 0; i < phases_.size(); ++i)
+    {
+        s << (i == 0 ? "" : ",") << "{\"name\":\"" << phases_[i].name << "\",\"seconds\":" << phases_[i].seconds
+          << ",\"calls\":" << phases_[i].calls << "}";
+    }
+    s << "],\"counters\":{";
+    for (size_t i = 0; i < counters_.size(); ++i)
+    {
+        s << (i == 0 ? "" : ",") << "\"" << counters_[i].name << "\":" << counters_[i].value;
+    }
+    s << "},\"peak_rss_bytes\":" << peak_rss() << "}" << '\n';
+}
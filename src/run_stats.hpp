@@ -0,0 +1,129 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timings of the phases of a run, and counts of what they processed, reported by --stats.
+//
+// The instrumentation is compiled in only if NINJA_TIMES_STATS is defined (by the CMake option of
+// the same name); otherwise the STATS_ macros below expand to nothing. When it is compiled in, but
+// --stats isn't given, each macro costs only a test of a flag.
+//
+// Phases and counters with the same name accumulate, so phases that run on several threads at
+// once (e.g. loading several logs) report their total time.
+class RunStats {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    static RunStats &instance();
+
+    void enable() { enabled_ = true; }
+    bool enabled() const { return enabled_; }
+
+    void add_time(const char *phase, double seconds);
+    void add_count(const char *counter, uint64_t value);
+
+    // Peak resident set size of the process, in bytes.
+    static uint64_t peak_rss();
+
+    // A table of phases, then counters.
+    void write(std::ostream &s, double totalSeconds) const;
+    void write_json(std::ostream &s, double totalSeconds) const;
+
+private:
+    struct Phase {
+        const char *name;
+        double seconds;
+        uint64_t calls;
+    };
+    struct Counter {
+        const char *name;
+        uint64_t value;
+    };
+
+    bool enabled_ = false;
+    mutable std::mutex mutex_;
+    std::vector<Phase> phases_; // in the order in which they first ran.
+    std::vector<Counter> counters_;
+};
+
+// Times a sequence of phases: each call to next() ends the current phase and starts another. The
+// last phase ends when the timer is destroyed.
+class StatsTimer {
+public:
+    StatsTimer(const char *phase) { next(phase); }
+    ~StatsTimer() { end(); }
+
+    StatsTimer(const StatsTimer &) = delete;
+    StatsTimer &operator=(const StatsTimer &) = delete;
+
+    void next(const char *phase)
+    {
+        end();
+        if (RunStats::instance().enabled())
+        {
+            phase_ = phase;
+            start_ = RunStats::clock_t::now();
+        }
+    }
+    void end()
+    {
+        if (phase_ != nullptr)
+        {
+            RunStats::instance().add_time(phase_, std::chrono::duration<double>(RunStats::clock_t::now() - start_).count());
+            phase_ = nullptr;
+        }
+    }
+
+private:
+    const char *phase_ = nullptr;
+    RunStats::clock_t::time_point start_;
+};
+
+#ifdef NINJA_TIMES_STATS
+// Starts timing phase in a new StatsTimer named timer.
+#define STATS_TIMER(timer, phase) StatsTimer timer(phase)
+// Ends timer's current phase, and starts timing phase.
+#define STATS_NEXT(timer, phase) timer.next(phase)
+// Ends timer's current phase.
+#define STATS_END(timer) timer.end()
+// Adds value to counter. value is evaluated only if stats are enabled.
+#define STATS_COUNT(counter, value)                                     \
+    do                                                                  \
+    {                                                                   \
+        if (RunStats::instance().enabled())                             \
+        {                                                               \
+            RunStats::instance().add_count(counter, (uint64_t)(value)); \
+        }                                                               \
+    } while (0)
+#else
+#define STATS_TIMER(timer, phase)
+#define STATS_NEXT(timer, phase)
+#define STATS_END(timer)
+#define STATS_COUNT(counter, value)
+#endif
@@ -0,0 +1,146 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "string_interner.hpp"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+static constexpr size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+StringInterner::StringInterner()
+    : shards_(new Shard[SHARDS])
+{
+}
+
+StringInterner::~StringInterner()
+{
+}
+
+std::string_view StringInterner::Shard::store(std::string_view text)
+{
+    if (text.length() > blockRemaining)
+    {
+        size_t size = std::max(ARENA_BLOCK_SIZE, text.length());
+        blocks.push_back(std::unique_ptr<char[]>(new char[size]));
+        blockPosition = blocks.back().get();
+        blockRemaining = size;
+    }
+    char *result = blockPosition;
+    memcpy(result, text.data(), text.length());
+    blockPosition += text.length();
+    blockRemaining -= text.length();
+    return std::string_view(result, text.length());
+}
+
+void StringInterner::Shard::grow()
+{
+    size_t size = std::max((size_t)256, slots.size() * 2);
+    size_t mask = size - 1;
+    slots.assign(size, 0);
+    for (size_t i = 0; i < strings.size(); ++i)
+    {
+        size_t slot = hashes[i] & mask;
+        while (slots[slot] != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = (uint32_t)(i + 1);
+    }
+}
+
+uint32_t StringInterner::intern(std::string_view text)
+{
+    size_t hash = std::hash<std::string_view>{}(text);
+    // high bits select the shard; low bits select the slot within the shard.
+    uint32_t shardIndex = (uint32_t)(hash >> 58) % SHARDS;
+    Shard &shard = shards_[shardIndex];
+
+    std::lock_guard lock{shard.mutex};
+    if (shard.slots.size() < (shard.strings.size() + 1) * 2)
+    {
+        shard.grow();
+    }
+    size_t mask = shard.slots.size() - 1;
+    size_t slot = hash & mask;
+    while (true)
+    {
+        uint32_t entry = shard.slots[slot];
+        if (entry == 0)
+        {
+            break;
+        }
+        size_t index = entry - 1;
+        if (shard.hashes[index] == hash && shard.strings[index] == text)
+        {
+            return (uint32_t)(index * SHARDS + shardIndex);
+        }
+        slot = (slot + 1) & mask;
+    }
+    size_t index = shard.strings.size();
+    shard.strings.push_back(shard.store(text));
+    shard.hashes.push_back(hash);
+    shard.slots[slot] = (uint32_t)(index + 1);
+    return (uint32_t)(index * SHARDS + shardIndex);
+}
+
+size_t StringInterner::size() const
+{
+    size_t result = 0;
+    for (uint32_t i = 0; i < SHARDS; ++i)
+    {
+        result += shards_[i].strings.size();
+    }
+    return result;
+}
+
+uint32_t StringInterner::max_id() const
+{
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < SHARDS; ++i)
+    {
+        size_t count = shards_[i].strings.size();
+        if (count != 0)
+        {
+            result = std::max(result, (uint32_t)((count - 1) * SHARDS + i + 1));
+        }
+    }
+    return result;
+}
+
+std::vector<uint32_t> StringInterner::sorted_ids() const
+{
+    std::vector<uint32_t> result;
+    result.reserve(size());
+    for (uint32_t i = 0; i < SHARDS; ++i)
+    {
+        for (size_t j = 0; j < shards_[i].strings.size(); ++j)
+        {
+            result.push_back((uint32_t)(j * SHARDS + i));
+        }
+    }
+    std::sort(result.begin(), result.end(),
+        [this](uint32_t a, uint32_t b)
+        {
+            return str(a) < str(b);
+        });
+    return result;
+}
@@ -0,0 +1,79 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Maps strings to 32-bit IDs, storing one copy of each distinct string in an arena.
+//
+// intern() may be called concurrently. The interner is split into shards, each with its own lock,
+// arena and table, selected by the hash of the string. IDs are allocated round-robin across
+// shards (id % SHARDS is the shard), so they are nearly dense: max_id() is close to size().
+class StringInterner {
+public:
+    static constexpr uint32_t SHARDS = 64;
+
+    StringInterner();
+    ~StringInterner();
+
+    uint32_t intern(std::string_view text);
+
+    // Views remain valid for the lifetime of the interner. Not safe to call concurrently with intern().
+    std::string_view str(uint32_t id) const
+    {
+        return shards_[id % SHARDS].strings[id / SHARDS];
+    }
+
+    size_t size() const;
+
+    // One more than the largest ID allocated so far.
+    uint32_t max_id() const;
+
+    bool is_valid(uint32_t id) const
+    {
+        const Shard &shard = shards_[id % SHARDS];
+        return id / SHARDS < shard.strings.size();
+    }
+
+    // All IDs, in lexical order of their strings.
+    std::vector<uint32_t> sorted_ids() const;
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        // open-addressed table of (local index + 1), with 0 marking an empty slot.
+        std::vector<uint32_t> slots;
+        std::vector<size_t> hashes;
+        std::vector<std::string_view> strings;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        size_t blockRemaining = 0;
+        char *blockPosition = nullptr;
+
+        std::string_view store(std::string_view text);
+        void grow();
+    };
+    std::unique_ptr<Shard[]> shards_;
+};
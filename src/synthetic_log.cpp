@@ -0,0 +1,190 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "synthetic_log.hpp"
+#include "ss.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <random>
+#include <stdexcept>
+
+static std::string makeFileName(size_t edge, size_t depth)
+{
+    constexpr size_t FILES_PER_DIRECTORY = 50;
+    constexpr size_t FAN_OUT = 6;
+    size_t directory = edge / FILES_PER_DIRECTORY;
+    std::string target = "/CMakeFiles/target" + std::to_string(directory % 97) + ".dir";
+
+    // directories of the target's CMakeLists.txt, the target, then directories within the target.
+    size_t outerDepth = (depth + 1) / 2;
+    std::string result = "src";
+    for (size_t level = 0; level < depth; ++level)
+    {
+        if (level == outerDepth)
+        {
+            result += target;
+        }
+        result += "/dir" + std::to_string(directory % FAN_OUT);
+        directory /= FAN_OUT;
+    }
+    if (outerDepth >= depth)
+    {
+        result += target;
+    }
+    result += "/File" + std::to_string(edge) + ((edge % 5 == 0) ? ".c.o" : ".cpp.o");
+    return result;
+}
+
+SyntheticLog::SyntheticLog(const SyntheticLogOptions &options)
+{
+    if (options.edges == 0 || options.jobs == 0)
+    {
+        throw std::invalid_argument("A synthetic log needs at least one edge, and one job.");
+    }
+    if (options.duplicate_ratio < 0 || options.duplicate_ratio >= 1 || options.rebuild_ratio <= 0 || options.rebuild_ratio > 1)
+    {
+        throw std::invalid_argument("Duplicate ratio must be in [0,1), and rebuild ratio in (0,1].");
+    }
+    fileNames_.reserve(options.edges);
+    for (size_t edge = 0; edge < options.edges; ++edge)
+    {
+        fileNames_.push_back(makeFileName(edge, options.depth));
+    }
+
+    std::mt19937_64 random(options.seed);
+    std::lognormal_distribution<double> durations(7.6, 1.0);
+    std::vector<uint32_t> durationScale(options.edges); // some files are always slow.
+    for (auto &scale : durationScale)
+    {
+        scale = 1 + (uint32_t)(random() % 4);
+    }
+
+    constexpr uint64_t FIRST_BUILD_TIME = 1690000000ULL * 1000000000ULL; // ns since the epoch.
+    constexpr uint64_t BUILD_INTERVAL = 2ULL * 3600 * 1000000000ULL;
+
+    struct Record {
+        uint64_t start, end, mtime;
+        uint32_t edge;
+        uint64_t hash;
+    };
+    auto runBuild = [&](size_t build)
+    {
+        std::vector<uint32_t> edges;
+        for (uint32_t edge = 0; edge < options.edges; ++edge)
+        {
+            if (build == 0 || std::generate_canonical<double, 32>(random) < options.rebuild_ratio)
+            {
+                edges.push_back(edge);
+            }
+        }
+        std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> lanes;
+        for (size_t i = 0; i < options.jobs; ++i)
+        {
+            lanes.push(0);
+        }
+        std::vector<Record> records;
+        records.reserve(edges.size());
+        uint64_t buildTime = FIRST_BUILD_TIME + build * BUILD_INTERVAL;
+        for (uint32_t edge : edges)
+        {
+            uint64_t start = lanes.top();
+            lanes.pop();
+            uint64_t duration = std::clamp<uint64_t>((uint64_t)(durations(random) * durationScale[edge] / 2), 10, 600000);
+            lanes.push(start + duration);
+            records.push_back(Record{start, start + duration, buildTime + (start + duration) * 1000000, edge, random()});
+        }
+        std::stable_sort(records.begin(), records.end(),
+            [](const Record &a, const Record &b)
+            {
+                return a.end < b.end;
+            });
+        return records;
+    };
+    auto writeRecord = [&](std::string &text, const Record &record)
+    {
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)record.hash);
+        text += std::to_string(record.start);
+        text += '\t';
+        text += std::to_string(record.end);
+        text += '\t';
+        text += std::to_string(record.mtime);
+        text += '\t';
+        text += fileNames_[record.edge];
+        text += '\t';
+        text += hash;
+        text += '\n';
+    };
+
+    std::vector<Record> lastBuild;
+    history_ = "# ninja log v5\n";
+    for (size_t build = 0; build < options.builds; ++build)
+    {
+        lastBuild = runBuild(build);
+        for (const Record &record : lastBuild)
+        {
+            writeRecord(history_, record);
+        }
+        historyRecordCount_ += lastBuild.size();
+    }
+
+    std::vector<Record> newBuild = runBuild(options.builds);
+    size_t duplicates = (size_t)std::llround(newBuild.size() * options.duplicate_ratio / (1 - options.duplicate_ratio));
+    duplicates = std::min(duplicates, lastBuild.size());
+    log_ = "# ninja log v5\n";
+    for (size_t i = lastBuild.size() - duplicates; i < lastBuild.size(); ++i)
+    {
+        writeRecord(log_, lastBuild[i]);
+    }
+    for (const Record &record : newBuild)
+    {
+        writeRecord(log_, record);
+    }
+    logRecordCount_ = duplicates + newBuild.size();
+}
+
+void SyntheticLog::write(const std::string &logFile) const
+{
+    std::string history = logFile + ".history";
+    for (const char *suffix : {".checkpoint", ".files", ".builds", ".bin", ".bin.checkpoint", ".bin.builds"})
+    {
+        std::filesystem::remove(history + suffix);
+    }
+    for (const auto &file : {std::make_pair(logFile, &log_), std::make_pair(history, &history_)})
+    {
+        std::ofstream f(file.first, std::ios_base::binary);
+        if (!f.is_open())
+        {
+            throw std::invalid_argument(SS("Can't open file " << file.first));
+        }
+        f.write(file.second->data(), file.second->size());
+        f.close();
+        if (!f)
+        {
+            throw std::invalid_argument(SS("Can't write file " << file.first));
+        }
+    }
+}
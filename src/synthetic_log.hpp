@@ -0,0 +1,74 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Parameters of a synthetic build history.
+struct SyntheticLogOptions {
+    size_t edges = 20000;          // distinct outputs in the project.
+    size_t depth = 4;              // directories in the path of each output, besides CMakeFiles/target.dir.
+    size_t builds = 20;            // builds in the history, before the build in the log.
+    double rebuild_ratio = 0.25;   // fraction of the edges that each build after the first rebuilds.
+    double duplicate_ratio = 0.5;  // fraction of the log's records that are already in the history.
+    size_t jobs = 16;              // edges that run at once.
+    uint64_t seed = 1;
+};
+
+// A synthetic .ninja_log, and the .ninja_log.history that earlier builds left, for benchmarks.
+//
+// Outputs are named as CMake names them (dir/CMakeFiles/target.dir/subdir/File.cpp.o), with
+// directories of about 50 files. Each build starts the ninja clock at 0, and runs its edges
+// on `jobs` lanes, with log-normally distributed durations (median ~2s); records are written
+// in the order in which the edges finished, as ninja writes them. The first build rebuilds
+// every edge.
+//
+// The log holds the records of a new build, preceded by the last records of the history,
+// which are duplicates that merging must remove.
+class SyntheticLog {
+public:
+    SyntheticLog(const SyntheticLogOptions &options);
+
+    const std::string &log() const { return log_; }
+    const std::string &history() const { return history_; }
+
+    size_t log_record_count() const { return logRecordCount_; }
+    size_t history_record_count() const { return historyRecordCount_; }
+
+    // Distinct output names, in edge order.
+    const std::vector<std::string> &file_names() const { return fileNames_; }
+
+    // Writes the log to logFile, and the history to logFile.history. Files that ninja_times keeps
+    // beside the history (checkpoints and indexes) are removed, so that the next load starts
+    // from scratch.
+    void write(const std::string &logFile) const;
+
+private:
+    std::string log_;
+    std::string history_;
+    size_t logRecordCount_ = 0;
+    size_t historyRecordCount_ = 0;
+    std::vector<std::string> fileNames_;
+};
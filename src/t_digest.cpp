@@ -0,0 +1,165 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "t_digest.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// The k1 scale function, which limits centroids to sizes proportional to q(1-q).
+static double scale(double q, double compression)
+{
+    return compression / (2 * M_PI) * std::asin(2 * q - 1);
+}
+
+static double inverseScale(double k, double compression)
+{
+    double angle = k * 2 * M_PI / compression;
+    return angle >= M_PI / 2 ? 1 : (std::sin(angle) + 1) / 2;
+}
+
+TDigest::TDigest(double compression)
+    : compression_(compression)
+{
+    if (compression < 10)
+    {
+        throw std::invalid_argument("t-digest compression must be at least 10.");
+    }
+}
+
+void TDigest::add(double value, double weight)
+{
+    if (count() == 0)
+    {
+        min_ = max_ = value;
+    }
+    else
+    {
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+    buffer_.push_back(Centroid{value, weight});
+    bufferWeight_ += weight;
+    if (buffer_.size() >= (size_t)(compression_ * 4))
+    {
+        compress();
+    }
+}
+
+void TDigest::merge(const TDigest &other)
+{
+    if (other.count() == 0)
+    {
+        return;
+    }
+    if (count() == 0)
+    {
+        min_ = other.min_;
+        max_ = other.max_;
+    }
+    else
+    {
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+    buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+    buffer_.insert(buffer_.end(), other.buffer_.begin(), other.buffer_.end());
+    bufferWeight_ += other.totalWeight_ + other.bufferWeight_;
+    compress();
+}
+
+void TDigest::compress() const
+{
+    if (buffer_.empty())
+    {
+        return;
+    }
+    buffer_.insert(buffer_.end(), centroids_.begin(), centroids_.end());
+    std::sort(buffer_.begin(), buffer_.end(),
+        [](const Centroid &v1, const Centroid &v2)
+        {
+            return v1.mean < v2.mean;
+        });
+    double total = totalWeight_ + bufferWeight_;
+
+    // merge neighbours for as long as the result spans no more than one unit of k.
+    centroids_.clear();
+    Centroid current = buffer_[0];
+    double weightSoFar = 0;
+    double limit = total * inverseScale(scale(0, compression_) + 1, compression_);
+    for (size_t i = 1; i < buffer_.size(); ++i)
+    {
+        const Centroid &next = buffer_[i];
+        if (weightSoFar + current.weight + next.weight <= limit)
+        {
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+        }
+        else
+        {
+            weightSoFar += current.weight;
+            centroids_.push_back(current);
+            limit = total * inverseScale(scale(weightSoFar / total, compression_) + 1, compression_);
+            current = next;
+        }
+    }
+    centroids_.push_back(current);
+
+    buffer_.clear();
+    totalWeight_ = total;
+    bufferWeight_ = 0;
+}
+
+double TDigest::quantile(double q) const
+{
+    compress();
+    if (centroids_.empty())
+    {
+        return 0;
+    }
+    q = std::clamp(q, 0.0, 1.0);
+    if (centroids_.size() == 1)
+    {
+        return centroids_[0].mean;
+    }
+
+    // interpolate between the centres of neighbouring centroids, and between the outermost
+    // centroids and the extreme values.
+    double index = q * totalWeight_;
+    const Centroid &first = centroids_.front();
+    if (index < first.weight / 2)
+    {
+        return min_ + (first.mean - min_) * index / (first.weight / 2);
+    }
+    double weightSoFar = first.weight / 2; // at the centre of centroid i.
+    for (size_t i = 0; i + 1 < centroids_.size(); ++i)
+    {
+        double gap = (centroids_[i].weight + centroids_[i + 1].weight) / 2;
+        if (index < weightSoFar + gap)
+        {
+            return centroids_[i].mean + (centroids_[i + 1].mean - centroids_[i].mean) * (index - weightSoFar) / gap;
+        }
+        weightSoFar += gap;
+    }
+    const Centroid &last = centroids_.back();
+    double tail = totalWeight_ - weightSoFar;
+    return tail <= 0 ? max_ : last.mean + (max_ - last.mean) * std::min(1.0, (index - weightSoFar) / tail);
+}
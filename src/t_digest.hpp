@@ -0,0 +1,67 @@
+// MIT License
+//
+// Copyright (c) 2023 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// A t-digest (Dunning and Ertl, 2019): a mergeable sketch that estimates quantiles of a stream of
+// values in bounded memory.
+//
+// Values are clustered into centroids (mean, weight). Centroids near the tails are kept small, so
+// extreme quantiles such as p99 stay accurate, while those near the median may absorb many
+// values. A digest holds at most about `compression` centroids, plus a buffer of values
+// that haven't been merged into them yet, however many values are added. Digests built
+// on separate threads can be merged into one.
+class TDigest {
+public:
+    TDigest(double compression = 100);
+
+    void add(double value, double weight = 1);
+    void merge(const TDigest &other);
+
+    double count() const { return totalWeight_ + bufferWeight_; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+
+    // Estimated value at quantile q (0..1). 0 if the digest is empty.
+    double quantile(double q) const;
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    // Merges the buffer into the centroids.
+    void compress() const;
+
+    double compression_;
+    double min_ = 0;
+    double max_ = 0;
+
+    // Compressed lazily, so that queries are const.
+    mutable std::vector<Centroid> centroids_;
+    mutable std::vector<Centroid> buffer_;
+    mutable double totalWeight_ = 0;
+    mutable double bufferWeight_ = 0;
+};